@@ -8,7 +8,9 @@
 #include <algorithm>
 #include <tuple>
 #include <cstdint>
+#include <cstddef>
 #include <concepts>
+#include <type_traits>
 
 namespace lic
 {
@@ -18,18 +20,102 @@ namespace lic
 
 	constexpr ComponentID MAX_COMPONENT = 32u;
 
+	// no component index of entity
+	constexpr size_t NO_INDEX = SIZE_MAX;
+
 	// forward declaration
 	class Entity;
 	class Component;
 	
 	// concepts
+	// components are stored by value, deriving from Component is optional
 	template <typename T>
-	concept IsComponent = std::is_base_of<Component, T>::value;
+	concept IsComponent = std::is_object<T>::value && !std::is_const<T>::value && std::movable<T>;
 
 	// ...also forward declaration... with concepts
 	template <IsComponent ...Ts>
 	class View;
 
+	// active state of component, components not derived from Component are always active
+	template <IsComponent T>
+	bool IsActive(const T& component)
+	{
+		if constexpr (std::is_base_of<Component, T>::value)
+			return component.is_active;
+		else
+			return true;
+	}
+
+
+	/*-------------POOL--------------*/
+
+
+	// type erased pool, for removal with component id
+	class ComponentPoolBase
+	{
+	public:
+
+		virtual ~ComponentPoolBase() = default;
+
+		// remove component of entity
+		virtual void Remove(EntityID entity) = 0;
+	};
+
+	// contiguous components of type T
+	// adding or removing components moves them, references to components are invalidated
+	template <IsComponent T>
+	class ComponentPool final : public ComponentPoolBase
+	{
+	public:
+
+		// components and their entities, same index
+		std::vector<T> components;
+		std::vector<EntityID> entities;
+
+		// index of component of each entity id, NO_INDEX if none
+		std::vector<size_t> sparse;
+
+		// index of component of entity, size of pool if none
+		size_t Find(EntityID entity) const
+		{
+			if (entity >= sparse.size() || sparse[entity] == NO_INDEX)
+				return entities.size();
+			return sparse[entity];
+		}
+
+		// add component to entity
+		template <typename ...TArgs>
+		T& Add(EntityID entity, TArgs&& ...args)
+		{
+			components.emplace_back(std::forward<TArgs>(args)...);
+			entities.push_back(entity);
+
+			if (entity >= sparse.size())
+				sparse.resize(entity + 1u, NO_INDEX);
+			sparse[entity] = entities.size() - 1u;
+
+			return components.back();
+		}
+
+		// remove component of entity, last component takes its place
+		void Remove(EntityID entity) override
+		{
+			size_t index = Find(entity);
+			if (index == entities.size())
+				return;
+
+			if (index + 1u != components.size())
+			{
+				components[index] = std::move(components.back());
+				entities[index] = entities.back();
+				sparse[entities[index]] = index;
+			}
+			components.pop_back();
+			entities.pop_back();
+			sparse[entity] = NO_INDEX;
+		}
+	};
+
 
 	/*-------------Manager--------------*/
 
@@ -38,11 +124,8 @@ namespace lic
 	{
 	private:
 
-		// list of list of components
-		std::array<std::vector<std::unique_ptr<Component>>, MAX_COMPONENT> m_components;
-
-		// list of removed components
-		std::array<std::vector<size_t>, MAX_COMPONENT> m_empty_component;
+		// pool of each component type, created with the first component of the type
+		std::array<std::unique_ptr<ComponentPoolBase>, MAX_COMPONENT> m_pools;
 
 		// currently the highest entity id
 		EntityID m_top_id;
@@ -57,8 +140,8 @@ namespace lic
 		EntityID m_next_entity_id = 0u;
 
 		// next id for component
-		// mutable for const GetComponentID<T>() function
-		mutable ComponentID m_next_component_id = 0u;
+		// shared by all managers, as the id of each component type is
+		inline static ComponentID m_next_component_id = 0u;
 
 	public:
 
@@ -109,24 +192,14 @@ namespace lic
 				return GetComponent<T>(entity);
 			}
 
-			T* cptr(new T(std::forward<TArgs>(args)...));
-			cptr->entity = entity;
-			cptr->manager = this;
-			auto& ref = *cptr;
-
-			ComponentID id = GetComponentID<T>();
-			if (m_empty_component.at(id).empty())
-			{
-				std::unique_ptr<Component> u_ptr{ cptr };
-				m_components.at(id).push_back(std::move(u_ptr));
-			}
-			else
+			T& ref = GetPool<T>().Add(entity, std::forward<TArgs>(args)...);
+			if constexpr (std::is_base_of<Component, T>::value)
 			{
-				m_components.at(id).at(m_empty_component.at(id).back()).reset(cptr);
-				m_empty_component.at(id).pop_back();
+				ref.entity = entity;
+				ref.manager = this;
 			}
 
-			m_checklist.at(entity).set(id);
+			m_checklist.at(entity).set(GetComponentID<T>());
 
 #ifdef LIC_DEBUG
 			std::cout << "Component " << typeid(T).name() << " added to Entity " << entity << "." << std::endl;
@@ -146,16 +219,8 @@ namespace lic
 				return;
 			}
 
-			for (auto& cptr : m_components.at(GetComponentID<T>()))
-			{
-				if (cptr != nullptr && cptr->entity == entity)
-				{
-					m_empty_component.at(GetComponentID<T>()).push_back(&cptr - &m_components.at(GetComponentID<T>())[0]);
-					m_checklist.at(cptr->entity).set(GetComponentID<T>(), false);
-					cptr.reset();
-					break;
-				}
-			}
+			GetPool<T>().Remove(entity);
+			m_checklist.at(entity).set(GetComponentID<T>(), false);
 
 #ifdef LIC_DEBUG
 			std::cout << "Component " << typeid(T).name() << " removed from Entity " << entity << "." << std::endl;
@@ -167,23 +232,18 @@ namespace lic
 		void RemoveComponent(EntityID entity, ComponentID cid);
 
 		// get component
+		// reference is invalidated by adding or removing components of type T
 		template <IsComponent T>
 		T& GetComponent(EntityID entity)
 		{
-			for (auto& cptr : m_components.at(GetComponentID<T>()))
-			{
-				if (cptr != nullptr && cptr->entity == entity)
-					return *static_cast<T*>(cptr.get());
-			}
+			auto& pool = GetPool<T>();
+			return pool.components.at(pool.Find(entity));
 		}
 		template <IsComponent T>
 		const T& GetComponent(EntityID entity) const
 		{
-			for (auto& cptr : m_components.at(GetComponentID<T>()))
-			{
-				if (cptr != nullptr && cptr->entity == entity)
-					return *static_cast<T*>(cptr.get());
-			}
+			auto& pool = GetPool<T>();
+			return pool.components.at(pool.Find(entity));
 		}
 
 		// has component
@@ -200,16 +260,37 @@ namespace lic
 
 	private:
 
+		// get pool of component T, create it if needed
+		template <IsComponent T>
+		ComponentPool<T>& GetPool()
+		{
+			auto& pool = m_pools.at(GetComponentID<T>());
+			if (pool == nullptr)
+				pool = std::make_unique<ComponentPool<T>>();
+			return static_cast<ComponentPool<T>&>(*pool);
+		}
+		// empty pool if no entity ever had component T
+		template <IsComponent T>
+		const ComponentPool<T>& GetPool() const
+		{
+			static const ComponentPool<T> empty;
+			const auto& pool = m_pools.at(GetComponentID<T>());
+			if (pool == nullptr)
+				return empty;
+			return static_cast<const ComponentPool<T>&>(*pool);
+		}
+
 		// filter out component U from view
 		template <IsComponent U, IsComponent T, IsComponent ...Ts>
 		void _ProcessMultiFilter(View<T, Ts...>& view, bool include_non_active)
 		{
+			const auto& entities = view.m_components.m_pool->entities;
 			std::erase_if(view.m_components.m_vec,
-						  [](T*& c) -> bool
+						  [&](size_t index) -> bool
 				{ 
-					if (!c->GetEntity().HasComponent<U>())
+					if (!HasComponent<U>(entities[index]))
 						return true;
-					else if (!c->GetEntity().GetComponent<U>().is_active)
+					else if (!include_non_active && !IsActive(GetComponent<U>(entities[index])))
 						return true;
 					else
 						return false;
@@ -225,13 +306,15 @@ namespace lic
 		{
 			View<T, Ts...> view(*this);
 
-			// get vector of component T
-			for (auto& cptr : m_components.at(GetComponentID<T>()))
+			// get indices of component T in its pool
+			auto& pool = GetPool<T>();
+			view.m_components.m_pool = &pool;
+			for (size_t index = 0u; index < pool.components.size(); ++index)
 			{
-				if (cptr == nullptr || !include_non_active && !cptr->is_active) 
+				if (!include_non_active && !IsActive(pool.components[index]))
 					continue;
 
-				view.m_components.m_vec.push_back(static_cast<T*>(cptr.get()));
+				view.m_components.m_vec.push_back(index);
 			}
 
 			// filter out components Ts...
@@ -239,8 +322,7 @@ namespace lic
 			(void)process;
 
 			// push entities
-			for (auto& c : view.m_components)
-				view.m_entities.m_vec.push_back(c.GetEntityID());
+			view._PushEntities();
 
 			return view;
 		}
@@ -264,8 +346,6 @@ namespace lic
 
 	public:
 
-		virtual ~Component() = default;
-
 		// active
 		bool is_active = true;
 
@@ -402,16 +482,8 @@ namespace lic
 			return;
 		}
 
-		for (auto& cptr : m_components.at(cid))
-		{
-			if (cptr != nullptr && cptr->entity == entity)
-			{
-				m_empty_component.at(cid).push_back(&cptr - &m_components.at(cid)[0]);
-				m_checklist.at(cptr->entity).set(cid, false);
-				cptr.reset();
-				break;
-			}
-		}
+		m_pools.at(cid)->Remove(entity);
+		m_checklist.at(entity).set(cid, false);
 
 #ifdef LIC_DEBUG
 		std::cout << "Component " << cid << " removed from Entity " << entity << "." << std::endl;
@@ -440,13 +512,16 @@ namespace lic
 		// index for iteration
 		size_t m_index;
 
-		// vec ref
-		std::vector<T*>& m_vec;
+		// components of pool
+		T* m_components;
+
+		// indices in pool ref
+		const std::vector<size_t>& m_vec;
 
 	public:
 
-		CContainerItr(std::vector<T*>& vec, const size_t index = 0u)
-			: m_index(index), m_vec(vec) {}
+		CContainerItr(T* components, const std::vector<size_t>& vec, const size_t index = 0u)
+			: m_index(index), m_components(components), m_vec(vec) {}
 
 		// operators for range-based for loop
 		bool operator!=(const CContainerItr& itr) const
@@ -462,7 +537,7 @@ namespace lic
 
 		T& operator*() const
 		{
-			return *m_vec.at(m_index);
+			return m_components[m_vec[m_index]];
 		}
 	};
 
@@ -476,21 +551,24 @@ namespace lic
 		friend class View<Ts...>;
 		friend class Manager;
 		
-		//backing vector
-		std::vector<T*> m_vec;
+		// pool of component T
+		ComponentPool<T>* m_pool = nullptr;
+
+		// backing vector, ascending indices in pool
+		std::vector<size_t> m_vec;
 
 	public:
 
 		CContainer() = default;
 
 		// begin and end methods for iterator
-		auto begin()
+		auto begin() const
 		{
-			return CContainerItr<T>(m_vec, 0);
+			return CContainerItr<T>(m_pool->components.data(), m_vec, 0);
 		}
-		auto end()
+		auto end() const
 		{
-			return CContainerItr<T>(m_vec, m_vec.size());
+			return CContainerItr<T>(m_pool->components.data(), m_vec, m_vec.size());
 		}
 	};
 
@@ -506,11 +584,11 @@ namespace lic
 		size_t m_index;
 
 		// vec ref
-		std::vector<EntityID>& m_vec;
+		const std::vector<EntityID>& m_vec;
 
 	public:
 
-		EContainerItr(Manager& manager, std::vector<EntityID>& vec, const size_t index)
+		EContainerItr(Manager& manager, const std::vector<EntityID>& vec, const size_t index)
 			: manager(manager), m_index(index), m_vec(vec) {}
 
 		// operators for range-based for loop
@@ -555,11 +633,11 @@ namespace lic
 			: manager(manager), m_vec(vec) {}
 
 		// begin and end methods for iterator
-		auto begin()
+		auto begin() const
 		{
 			return EContainerItr<T, Ts...>(manager, m_vec, 0u);
 		}
-		auto end()
+		auto end() const
 		{
 			return EContainerItr<T, Ts...>(manager, m_vec, m_vec.size());
 		}
@@ -579,19 +657,28 @@ namespace lic
 		Manager& manager;
 
 		// entities and component T
-		EContainer<Entity, Ts...> m_entities;
+		EContainer<lic::Entity, Ts...> m_entities;
 		CContainer<Ts...> m_components;
 
 		// filter out non-component U from view
 		template <IsComponent U, IsComponent S, IsComponent ...Ss>
 		void _ProcessMultiFilterOut(View<S, Ss...>& view) const
 		{
+			const auto& entities = view.m_components.m_pool->entities;
 			std::erase_if(view.m_components.m_vec,
-						  [](S*& c) -> bool
-						  { return c->GetEntity().HasComponent<U>(); }
+						  [&](size_t index) -> bool
+						  { return manager.HasComponent<U>(entities[index]); }
 			);
 		}
 
+		// push entities of components
+		void _PushEntities()
+		{
+			m_entities.m_vec.clear();
+			for (size_t index : m_components.m_vec)
+				m_entities.m_vec.push_back(m_components.m_pool->entities[index]);
+		}
+
 	public:
 
 		View(Manager& manager) : manager(manager), m_entities(manager) {}
@@ -603,9 +690,7 @@ namespace lic
 			int process[] = { 0, (_ProcessMultiFilterOut<Us, Ts...>(*this), 0)... };
 			(void)process;
 
-			m_entities.m_vec.clear();
-			for (auto& c : m_components)
-				m_entities.m_vec.push_back(c.GetEntityID());
+			_PushEntities();
 
 			return *this;
 		}
@@ -617,9 +702,7 @@ namespace lic
 			int process[] = { 0, (_ProcessMultiFilterOut<Us, Ts...>(view), 0)... };
 			(void)process;
 
-			view.m_entities.m_vec.clear();
-			for (auto& c : view.m_components)
-				view.m_entities.m_vec.push_back(c.GetEntityID());
+			view._PushEntities();
 
 			return view;
 		}
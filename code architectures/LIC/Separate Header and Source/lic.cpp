@@ -59,16 +59,8 @@ namespace lic
 			return;
 		}
 
-		for (auto& cptr : m_components.at(cid))
-		{
-			if (cptr != nullptr && cptr->entity == entity)
-			{
-				m_empty_component.at(cid).push_back(&cptr - &m_components.at(cid)[0]);
-				m_checklist.at(cptr->entity).set(cid, false);
-				cptr.reset();
-				break;
-			}
-		}
+		m_pools.at(cid)->Remove(entity);
+		m_checklist.at(entity).set(cid, false);
 
 #ifdef LIC_DEBUG
 		std::cout << "Component " << cid << " removed from Entity " << entity << "." << std::endl;
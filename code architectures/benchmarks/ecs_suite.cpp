@@ -0,0 +1,432 @@
+// the same scenarios run on lecs::EntityManager and lic::Manager
+// reports ns/op and allocations/op, allocations are counted by tools/mem_usage
+// results are also written as JSON, so that runs of different commits can be compared
+// every scenario uses its own fixed seed, so both libraries and all runs do the same operations
+// build: g++ -std=c++20 -O2 -I.. ecs_suite.cpp ../../tools/mem_usage/mem_usage.cpp -o ecs_suite
+// usage: ecs_suite [entities] [output file] [label, for example the commit]
+// snapshot_restore restores SNAPSHOT_BACK frames back, run it with 50000 entities for the rollback target of lecs
+
+#define LECS_LOG_LEVEL LECS_LEVEL_ERROR
+#include "lecs.hpp"
+#include "LIC/Header-only/lic.hpp"
+#include "../../tools/mem_usage/mem_usage.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// result of one scenario on one library
+struct Result
+{
+	const char* library;
+	const char* scenario;
+	std::size_t ops;
+
+	// false if the library has no equivalent of the scenario
+	bool run;
+
+	double ns_per_op;
+	double allocations_per_op;
+};
+
+// checksum of the components read, printed so that the work can not be optimized away
+static double checksum = 0.;
+
+// time fn, which does ops operations, and count the allocations it makes
+template <typename F>
+Result Measure(const char* library, const char* scenario, std::size_t ops, F fn)
+{
+	std::size_t allocations = lio::memory_allocations;
+	auto begin = std::chrono::steady_clock::now();
+	fn();
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	allocations = lio::memory_allocations - allocations;
+	return Result{ library, scenario, ops, true, ns / ops, static_cast<double>(allocations) / ops };
+}
+
+// scenario sizes, ops are per entity of the world unless said otherwise
+constexpr uint32_t ITERATE_SINGLE_PASSES = 20;
+constexpr uint32_t ITERATE_MULTI_PASSES = 5;
+constexpr uint32_t FILTERS = 10;
+constexpr uint32_t EVENT_HANDLERS = 16;
+
+// restores of snapshot scenarios, each SNAPSHOT_BACK frames back
+// one entity in SNAPSHOT_CHURN is destroyed and one created every frame of the churn scenario
+constexpr uint32_t SNAPSHOT_RESTORES = 20;
+constexpr uint32_t SNAPSHOT_BACK = 8;
+constexpr uint32_t SNAPSHOT_CHURN = 100;
+
+// seeds of the scenarios
+constexpr uint32_t CHURN_SEED = 1;
+constexpr uint32_t ADD_REMOVE_SEED = 2;
+constexpr uint32_t RANDOM_GET_SEED = 3;
+constexpr uint32_t SNAPSHOT_SEED = 4;
+
+namespace bench_lecs
+{
+	struct Position : lecs::Component
+	{
+		float x = 0.f, y = 0.f;
+	};
+
+	struct Velocity : lecs::Component
+	{
+		float x = 1.f, y = 0.5f;
+	};
+
+	struct Health : lecs::Component
+	{
+		int value = 100;
+	};
+
+	struct Damaged
+	{
+		uint32_t entity;
+		explicit Damaged(uint32_t entity) : entity(entity) {}
+	};
+
+	struct DamageCounter
+	{
+		uint32_t damaged = 0;
+		void operator()(const Damaged& event) { damaged += event.entity; }
+	};
+
+	// world of n entities with Position and Velocity, return their ids
+	std::vector<uint32_t> Populate(lecs::EntityManager& entity_manager, uint32_t n)
+	{
+		std::vector<uint32_t> ids;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			auto& e = entity_manager.AddEntity();
+			e.AddComponent<Position>();
+			e.AddComponent<Velocity>();
+			ids.push_back(e.id);
+		}
+		return ids;
+	}
+
+	void Run(std::vector<Result>& results, uint32_t n)
+	{
+		const char* lib = "lecs";
+
+		// destroy a random entity and create a new one
+		{
+			lecs::EntityManager entity_manager;
+			auto ids = Populate(entity_manager, n);
+			std::mt19937 rng(CHURN_SEED);
+			results.push_back(Measure(lib, "create_destroy", n, [&]()
+			{
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					uint32_t& id = ids[rng() % n];
+					entity_manager.GetEntity(id).Destroy(true);
+					auto& e = entity_manager.AddEntity();
+					e.AddComponent<Position>();
+					e.AddComponent<Velocity>();
+					id = e.id;
+				}
+			}));
+		}
+
+		// add and remove a component of a random entity, each counts as an op
+		{
+			lecs::EntityManager entity_manager;
+			auto ids = Populate(entity_manager, n);
+			std::mt19937 rng(ADD_REMOVE_SEED);
+			results.push_back(Measure(lib, "add_remove_component", 2 * n, [&]()
+			{
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					auto& e = entity_manager.GetEntity(ids[rng() % n]);
+					e.AddComponent<Health>();
+					e.RemoveComponent<Health>();
+				}
+			}));
+		}
+
+		lecs::EntityManager entity_manager;
+		auto ids = Populate(entity_manager, n);
+
+		// each entity visited counts as an op
+		results.push_back(Measure(lib, "iterate_single", n * ITERATE_SINGLE_PASSES, [&]()
+		{
+			for (uint32_t pass = 0; pass < ITERATE_SINGLE_PASSES; ++pass)
+			{
+				entity_manager.ForEach<const Position>([](lecs::Entity&, const Position& p)
+				{
+					checksum += p.x;
+				});
+			}
+		}));
+
+		results.push_back(Measure(lib, "iterate_multi", n * ITERATE_MULTI_PASSES, [&]()
+		{
+			for (uint32_t pass = 0; pass < ITERATE_MULTI_PASSES; ++pass)
+			{
+				entity_manager.ForEach<Position, const Velocity>([](lecs::Entity&, Position& p, const Velocity& v)
+				{
+					p.x += v.x;
+					p.y += v.y;
+				});
+			}
+		}));
+
+		// each filter counts as an op
+		results.push_back(Measure(lib, "filter", FILTERS, [&]()
+		{
+			for (uint32_t i = 0; i < FILTERS; ++i)
+			{
+				checksum += static_cast<double>(entity_manager.EntityFilter<Position, Velocity>().entities.size());
+			}
+		}));
+
+		results.push_back(Measure(lib, "random_get_component", n, [&]()
+		{
+			std::mt19937 rng(RANDOM_GET_SEED);
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				checksum += entity_manager.GetEntity(ids[rng() % n]).GetComponent<Position>().x;
+			}
+		}));
+
+		// each restore counts as an op, only restoring is timed
+		// every frame moves all entities, and destroys and creates some if churn is true
+		auto snapshot_restore = [&](const char* scenario, bool churn)
+		{
+			lecs::EntityManager world;
+			auto world_ids = Populate(world, n);
+			lecs::SnapshotRing ring;
+			std::mt19937 rng(SNAPSHOT_SEED);
+			uint32_t frame = 0;
+			ring.Save(world, frame);
+
+			Result result{ lib, scenario, SNAPSHOT_RESTORES, true, 0., 0. };
+			for (uint32_t i = 0; i < SNAPSHOT_RESTORES; ++i)
+			{
+				for (uint32_t f = 0; f < SNAPSHOT_BACK; ++f)
+				{
+					world.AdvanceChangeTick();
+					world.ForEach<Position, const Velocity>([](lecs::Entity&, Position& p, const Velocity& v)
+					{
+						p.x += v.x;
+						p.y += v.y;
+					});
+					for (uint32_t c = 0; churn && c < n / SNAPSHOT_CHURN; ++c)
+					{
+						uint32_t& id = world_ids[rng() % n];
+						world.GetEntity(id).Destroy(true);
+						auto& e = world.AddEntity();
+						e.AddComponent<Position>();
+						e.AddComponent<Velocity>();
+						id = e.id;
+					}
+					ring.Save(world, ++frame);
+				}
+
+				frame -= SNAPSHOT_BACK;
+				Result r = Measure(lib, scenario, 1, [&]() { ring.Restore(world, frame); });
+				result.ns_per_op += r.ns_per_op / SNAPSHOT_RESTORES;
+				result.allocations_per_op += r.allocations_per_op / SNAPSHOT_RESTORES;
+
+				// entities created after the restored frame are gone
+				world_ids.clear();
+				for (auto& e : world.entities)
+				{
+					if (e) world_ids.push_back(e->id);
+				}
+			}
+			checksum += static_cast<double>(world.entities.size());
+			results.push_back(result);
+		};
+		snapshot_restore("snapshot_restore", false);
+		snapshot_restore("snapshot_restore_churn", true);
+
+		// each event delivered to a handler counts as an op
+		{
+			lecs::EventManager event_manager;
+			std::vector<DamageCounter> counters(EVENT_HANDLERS);
+			for (auto& counter : counters) event_manager.AddHandler<Damaged>(counter);
+			results.push_back(Measure(lib, "event_fan_out", n * EVENT_HANDLERS, [&]()
+			{
+				for (uint32_t i = 0; i < n; ++i) event_manager.Emit<Damaged>(i);
+			}));
+			for (auto& counter : counters) checksum += counter.damaged;
+		}
+	}
+}
+
+namespace bench_lic
+{
+	struct Position : lic::Component
+	{
+		float x = 0.f, y = 0.f;
+	};
+
+	struct Velocity : lic::Component
+	{
+		float x = 1.f, y = 0.5f;
+	};
+
+	struct Health : lic::Component
+	{
+		int value = 100;
+	};
+
+	// world of n entities with Position and Velocity, return their ids
+	std::vector<lic::EntityID> Populate(lic::Manager& manager, uint32_t n)
+	{
+		std::vector<lic::EntityID> ids;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			auto e = manager.AddEntity();
+			e.AddComponent<Position>();
+			e.AddComponent<Velocity>();
+			ids.push_back(e.GetID());
+		}
+		return ids;
+	}
+
+	void Run(std::vector<Result>& results, uint32_t n)
+	{
+		const char* lib = "lic";
+
+		{
+			lic::Manager manager;
+			auto ids = Populate(manager, n);
+			std::mt19937 rng(CHURN_SEED);
+			results.push_back(Measure(lib, "create_destroy", n, [&]()
+			{
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					lic::EntityID& id = ids[rng() % n];
+					manager.DestroyEntity(id);
+					auto e = manager.AddEntity();
+					e.AddComponent<Position>();
+					e.AddComponent<Velocity>();
+					id = e.GetID();
+				}
+			}));
+		}
+
+		{
+			lic::Manager manager;
+			auto ids = Populate(manager, n);
+			std::mt19937 rng(ADD_REMOVE_SEED);
+			results.push_back(Measure(lib, "add_remove_component", 2 * n, [&]()
+			{
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					lic::EntityID id = ids[rng() % n];
+					manager.AddComponent<Health>(id);
+					manager.RemoveComponent<Health>(id);
+				}
+			}));
+		}
+
+		lic::Manager manager;
+		auto ids = Populate(manager, n);
+
+		// iterating needs a view, so building it is part of the iteration
+		results.push_back(Measure(lib, "iterate_single", n * ITERATE_SINGLE_PASSES, [&]()
+		{
+			for (uint32_t pass = 0; pass < ITERATE_SINGLE_PASSES; ++pass)
+			{
+				auto positions = manager.Filter<Position>().Component();
+				for (auto& p : positions) checksum += p.x;
+			}
+		}));
+
+		results.push_back(Measure(lib, "iterate_multi", n * ITERATE_MULTI_PASSES, [&]()
+		{
+			for (uint32_t pass = 0; pass < ITERATE_MULTI_PASSES; ++pass)
+			{
+				auto view = manager.Filter<Position, Velocity>();
+				for (auto [p, v] : view.Each())
+				{
+					p.x += v.x;
+					p.y += v.y;
+				}
+			}
+		}));
+
+		results.push_back(Measure(lib, "filter", FILTERS, [&]()
+		{
+			for (uint32_t i = 0; i < FILTERS; ++i)
+			{
+				auto view = manager.Filter<Position, Velocity>();
+				for (auto e : view) checksum += e.GetID();
+			}
+		}));
+
+		results.push_back(Measure(lib, "random_get_component", n, [&]()
+		{
+			std::mt19937 rng(RANDOM_GET_SEED);
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				checksum += manager.GetComponent<Position>(ids[rng() % n]).x;
+			}
+		}));
+
+		// lic has no snapshots and no events
+		results.push_back(Result{ lib, "snapshot_restore", 0, false, 0., 0. });
+		results.push_back(Result{ lib, "snapshot_restore_churn", 0, false, 0., 0. });
+		results.push_back(Result{ lib, "event_fan_out", 0, false, 0., 0. });
+	}
+}
+
+// write results as JSON to path
+static bool WriteJson(const char* path, const char* label, uint32_t n, const std::vector<Result>& results)
+{
+	std::FILE* file = std::fopen(path, "w");
+	if (file == nullptr) return false;
+
+	// escape quotes and backslashes of the label, as it comes from the command line
+	std::string escaped;
+	for (const char* c = label; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\') escaped += '\\';
+		escaped += *c;
+	}
+
+	std::fprintf(file, "{\n  \"label\": \"%s\",\n  \"entities\": %u,\n  \"results\": [\n", escaped.c_str(), n);
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		std::fprintf(file, "    { \"library\": \"%s\", \"scenario\": \"%s\", \"ops\": %zu, ", r.library, r.scenario, r.ops);
+		if (r.run) std::fprintf(file, "\"ns_per_op\": %.3f, \"allocations_per_op\": %.4f }", r.ns_per_op, r.allocations_per_op);
+		else std::fprintf(file, "\"ns_per_op\": null, \"allocations_per_op\": null }");
+		std::fprintf(file, "%s\n", i + 1 < results.size() ? "," : "");
+	}
+	std::fprintf(file, "  ]\n}\n");
+	return std::fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t n = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 10000;
+	const char* path = argc > 2 ? argv[2] : "ecs_suite.json";
+	const char* label = argc > 3 ? argv[3] : "";
+
+	std::vector<Result> results;
+	bench_lecs::Run(results, n);
+	bench_lic::Run(results, n);
+
+	std::printf("%u entities\n", n);
+	std::printf("%-8s %-22s %12s %14s %16s\n", "library", "scenario", "ops", "ns/op", "allocations/op");
+	for (const auto& r : results)
+	{
+		if (r.run) std::printf("%-8s %-22s %12zu %14.1f %16.3f\n", r.library, r.scenario, r.ops, r.ns_per_op, r.allocations_per_op);
+		else std::printf("%-8s %-22s %12s %14s %16s\n", r.library, r.scenario, "-", "-", "-");
+	}
+	std::printf("checksum %g\n", checksum);
+
+	if (!WriteJson(path, label, n, results))
+	{
+		std::printf("can not write %s\n", path);
+		return 1;
+	}
+	return 0;
+}
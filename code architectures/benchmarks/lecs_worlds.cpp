@@ -0,0 +1,140 @@
+// throughput of independent lecs worlds updated on their own threads
+// each world simulates the same number of entities, so throughput should scale with the number of worlds up to the number of cores
+// build: g++ -std=c++14 -O2 -I.. lecs_worlds.cpp -o lecs_worlds -pthread
+// usage: lecs_worlds [entities per world] [frames]
+
+#define LECS_LOG_LEVEL LECS_LEVEL_ERROR
+#include "lecs.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+
+struct Position : lecs::Component
+{
+	float x = 0.f, y = 0.f;
+};
+
+struct Velocity : lecs::Component
+{
+	float x = 1.f, y = 0.5f;
+};
+
+struct Health : lecs::Component
+{
+	int value = 100;
+};
+
+struct Damaged
+{
+	uint32_t entity;
+	explicit Damaged(uint32_t entity) : entity(entity) {}
+};
+
+class MovementSystem : public lecs::System
+{
+public:
+
+	void Init(lecs::EntityManager&, lecs::EventManager&, lecs::SystemManager&) override
+	{
+		Reads<Velocity>();
+		Writes<Position>();
+	}
+
+	void Update(lecs::EntityManager& entity_manager, lecs::EventManager&, DeltaTime) override
+	{
+		entity_manager.ForEach<Position, const Velocity>([](lecs::Entity&, Position& p, const Velocity& v)
+		{
+			p.x += v.x;
+			p.y += v.y;
+		});
+	}
+};
+
+class DamageSystem : public lecs::System
+{
+public:
+
+	uint32_t frame = 0;
+
+	void Update(lecs::EntityManager& entity_manager, lecs::EventManager& event_manager, DeltaTime) override
+	{
+		++frame;
+		entity_manager.ForEach<Health>([this, &event_manager](lecs::Entity& e, Health& h)
+		{
+			if ((e.id + frame) % 64 != 0) return;
+			--h.value;
+			event_manager.Enqueue<Damaged>(e.id);
+		});
+	}
+};
+
+// run one world and return its checksum so the work can not be optimized away
+static double RunWorld(uint32_t n_entity, uint32_t n_frame)
+{
+	lecs::ECSManagers world;
+	world.system_manager->AddSystem<MovementSystem>();
+	world.system_manager->AddSystem<DamageSystem>();
+
+	uint32_t damaged = 0;
+	auto handler = [&damaged](const Damaged&) { ++damaged; };
+	world.event_manager->AddHandler<Damaged>(handler);
+
+	lecs::Prefab prefab;
+	prefab.Add<Position>().Add<Velocity>().Add<Health>();
+	world.entity_manager->Spawn(prefab, n_entity);
+
+	for (uint32_t frame = 0; frame < n_frame; ++frame)
+	{
+		world.UpdateECSManagers(1);
+	}
+
+	double checksum = damaged;
+	world.entity_manager->ForEach<const Position>([&checksum](lecs::Entity&, const Position& p)
+	{
+		checksum += p.x + p.y;
+	});
+	return checksum;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t n_entity = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+	uint32_t n_frame = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 100;
+	uint32_t n_core = std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("%u entities per world, %u frames, %u cores\n", n_entity, n_frame, n_core);
+	std::printf("%8s %12s %20s %10s\n", "worlds", "time (ms)", "entity updates/s", "speedup");
+
+	double base = 0.;
+	for (uint32_t n_world = 1; n_world <= n_core * 2; n_world *= 2)
+	{
+		std::vector<double> checksums(n_world);
+		std::vector<std::thread> threads;
+
+		auto begin = std::chrono::steady_clock::now();
+		for (uint32_t w = 0; w < n_world; ++w)
+		{
+			threads.emplace_back([&checksums, w, n_entity, n_frame]()
+			{
+				checksums[w] = RunWorld(n_entity, n_frame);
+			});
+		}
+		for (auto& t : threads) t.join();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		// every world does the same work, so all checksums must match
+		for (auto checksum : checksums)
+		{
+			if (checksum != checksums[0])
+			{
+				std::printf("worlds diverged\n");
+				return 1;
+			}
+		}
+
+		double throughput = static_cast<double>(n_world) * n_entity * n_frame / seconds;
+		if (n_world == 1) base = throughput;
+		std::printf("%8u %12.1f %20.0f %9.2fx\n", n_world, seconds * 1000., throughput, throughput / base);
+	}
+	return 0;
+}
@@ -1,13 +1,78 @@
 #pragma once
 
 #include <iostream>
+#include <iterator>
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <string>
 #include <memory>
 #include <array>
 #include <vector>
 #include <bitset>
 #include <queue>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <typeinfo>
+#include <new>
+#include <utility>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+// sse2 is used to match component signatures when available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LECS_SSE2
+#include <emmintrin.h>
+#endif
+
+// log levels
+// logs above LECS_LOG_LEVEL are removed at compile time
+#define LECS_LEVEL_NONE 0
+#define LECS_LEVEL_ERROR 1
+#define LECS_LEVEL_WARNING 2
+#define LECS_LEVEL_INFO 3
+
+// define before including to change the log level
+#ifndef LECS_LOG_LEVEL
+#define LECS_LOG_LEVEL LECS_LEVEL_INFO
+#endif
+
+// logs are added to the logger of the world returned by GetLogger() of the calling class
+#if LECS_LOG_LEVEL >= LECS_LEVEL_ERROR
+#define LECS_LOG_ERROR(...) GetLogger().Log(__VA_ARGS__)
+#else
+#define LECS_LOG_ERROR(...) ((void)0)
+#endif
+
+#if LECS_LOG_LEVEL >= LECS_LEVEL_WARNING
+#define LECS_LOG_WARNING(...) GetLogger().Log(__VA_ARGS__)
+#else
+#define LECS_LOG_WARNING(...) ((void)0)
+#endif
+
+#if LECS_LOG_LEVEL >= LECS_LEVEL_INFO
+#define LECS_LOG_INFO(...) GetLogger().Log(__VA_ARGS__)
+#else
+#define LECS_LOG_INFO(...) ((void)0)
+#endif
+
+// define LECS_PROFILE before including to record the time, entities touched and allocations of each system
+// profiling code is removed at compile time otherwise
+#ifdef LECS_PROFILE
+#define LECS_PROFILE_ENTITIES(n) (lecs::GetProfileCounters().entities += (n))
+#define LECS_PROFILE_ALLOCATION() (++lecs::GetProfileCounters().allocations)
+#else
+#define LECS_PROFILE_ENTITIES(n) ((void)0)
+#define LECS_PROFILE_ALLOCATION() ((void)0)
+#endif
 
 // unit of time of difference in time between the previous frame the next frame
 // to be passed into systems
@@ -19,9 +84,124 @@ namespace lecs
 	// max number of log stored
 	constexpr std::size_t MAX_LOG = 32;
 
-	// max number of component
+	// size in bytes of each chunk of an archetype
+	// entities with the same set of components are stored together in chunks
 	// change if needed
-	constexpr std::size_t MAX_COMPONENT = 32;
+	constexpr std::size_t CHUNK_SIZE = 16384;
+
+	// id used in logs when there is no entity or type
+	constexpr uint32_t NULL_ID = UINT32_MAX;
+
+	// first bit of the temporary ids of entities created by command buffer
+	constexpr uint32_t PENDING_ID = 0x80000000u;
+
+	// size in bytes of each memory block of command buffer
+	constexpr std::size_t COMMAND_BLOCK_SIZE = 4096;
+
+	// number of entities allocated at once by the entity pool
+	constexpr std::size_t ENTITY_SLAB_SIZE = 1024;
+
+	// number of archetype chunks allocated at once by the chunk pool
+	constexpr std::size_t CHUNK_SLAB_SIZE = 16;
+
+	// max size in bytes of event posted from other threads
+	constexpr std::size_t EVENT_SLOT_SIZE = 64;
+
+	// number of event posted from other threads that can be waiting for dispatch
+	// must be a power of 2
+	constexpr std::size_t EVENT_QUEUE_SIZE = 4096;
+
+	// number of frames kept in the profile history of system manager
+	constexpr std::size_t PROFILE_FRAMES = 256;
+
+	// default number of entities per job of parallel for each over entities not stored in archetype chunks
+	constexpr std::size_t PARALLEL_GRAIN = 1024;
+
+	// default number of frames kept by snapshot ring
+	constexpr std::size_t SNAPSHOT_FRAMES = 16;
+
+	// number of entity ids in each page of the entity table saved by snapshots
+	// only the pages changed since the previous snapshot are copied
+	constexpr std::size_t TABLE_PAGE_SIZE = 1024;
+
+	// first 4 bytes of the binary format of worlds, "LECS"
+	constexpr uint32_t SERIAL_MAGIC = 0x5343454C;
+
+	// version of the binary format of worlds written by EntityManager::Save
+	constexpr uint32_t SERIAL_VERSION = 1;
+
+	// alignment in bytes of the blocks of the binary format of worlds
+	constexpr std::size_t SERIAL_ALIGN = 16;
+
+	// max number of subtrees moved one by one when sorting a hierarchy, all nodes are sorted again if more changed
+	// moving a subtree and sorting all nodes both take linear time, sorting all about as long as this many moves
+	constexpr std::size_t HIERARCHY_MOVES = 32;
+
+	// counters of the calling thread used by profiling
+	struct ProfileCounters
+	{
+		// small id of the thread
+		uint32_t thread;
+
+		// entities visited by queries
+		uint64_t entities = 0;
+
+		// allocations made by lecs allocators and reported by ProfileAllocation
+		uint64_t allocations = 0;
+
+		ProfileCounters()
+		{
+			static std::atomic<uint32_t> next_thread{ 0 };
+			thread = next_thread++;
+		}
+	};
+
+	inline ProfileCounters& GetProfileCounters()
+	{
+		static thread_local ProfileCounters counters;
+		return counters;
+	}
+
+	// report an allocation to the profiler, e.g. from a replaced operator new
+	inline void ProfileAllocation()
+	{
+		LECS_PROFILE_ALLOCATION();
+	}
+
+	class EntityManager;
+
+	// change ticks of the system running on the calling thread
+	struct SystemTicks
+	{
+		// entity manager the system runs on, null outside of systems
+		const EntityManager* entity_manager = nullptr;
+
+		// tick written to changed components and tick the system last ran
+		uint32_t tick = 0;
+		uint32_t last_run = 0;
+	};
+
+	inline SystemTicks& GetSystemTicks()
+	{
+		static thread_local SystemTicks ticks;
+		return ticks;
+	}
+
+	// check whether tick is after since, allowing the ticks to wrap around
+	inline bool IsNewerTick(uint32_t tick, uint32_t since)
+	{
+		return static_cast<int32_t>(tick - since) > 0;
+	}
+
+	// check whether one of the n ticks is at or after tick
+	inline bool HasTickSince(const uint32_t* ticks, std::size_t n, uint32_t tick)
+	{
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			if (!IsNewerTick(tick, ticks[i])) return true;
+		}
+		return false;
+	}
 
 	// tags for logs
 	// optionally add custom tags
@@ -40,46 +220,93 @@ namespace lecs
 		LT_SIZE
 	};
 
+	// messages of logs
+	// the string of a log is only made when it is read
+	enum LogMessage
+	{
+		LM_CUSTOM,
+		LM_COMPONENT_ADDED,
+		LM_COMPONENT_REMOVED,
+		LM_COMPONENT_MISSING,
+		LM_COMPONENT_NOT_REMOVED,
+		LM_ENTITY_CREATED,
+		LM_ENTITY_DESTROYED,
+		LM_ENTITY_NULL,
+		LM_ENTITIES_SPAWNED,
+		LM_ENTITIES_COMPACTED,
+		LM_EVENT_CREATED,
+		LM_EVENT_EMITTED,
+		LM_SYSTEM_CREATED,
+		LM_SYSTEM_MISSING,
+	};
+
+	// structured log entry
+	struct LogRecord
+	{
+		LogMessage message;
+		std::bitset<LT_SIZE> tags;
+
+		// id of the entity and the component, event or system type concerned
+		// for spawned entities, the first entity and the number of entities
+		// for compaction, the number of entity ids before and after
+		uint32_t entity;
+		uint32_t type;
+		const char* type_name;
+
+		// nanoseconds since the logger is created
+		uint64_t timestamp;
+	};
+
 	// logger class for storing logs and log related functions
+	// logs are stored as records in a fixed size ring buffer
 	class Logger
 	{
 	public:
 
-		// add log
+		Logger() : epoch(std::chrono::steady_clock::now()) {}
+
+		// add structured log
+		// safe to call from multiple threads
+		// prefer LECS_LOG_ERROR, LECS_LOG_WARNING and LECS_LOG_INFO so that logs can be removed at compile time
 		template <typename... T>
-		void AddLog(std::string log_msg, T... tag)
+		void Log(LogMessage message, uint32_t entity, uint32_t type, const char* type_name, T... tag)
 		{
-			LogTag tags[] = { tag... };
-			std::pair<std::bitset<n_tag>, std::string> log;
-
-			bool shown = false;
-			log.second = log_msg;
-			for (auto t : tags)
-			{
-				log.first[t] = true;
-				log_per_tag[t] = log_msg;
-
-				if (show[t] && !shown)
-				{
-					std::cout << log_msg << std::endl;
-					shown = true;
-				}
-			}
-
-			logs.push_front(log);
+			std::lock_guard<std::mutex> lock(mutex);
+
+			LogRecord& record = Push();
+			record.message = message;
+			record.entity = entity;
+			record.type = type;
+			record.type_name = type_name;
+			Tag(record, tag...);
+		}
 
-			if (logs.size() > MAX_LOG) logs.pop_back();
+		// add log with custom message
+		template <typename... T>
+		void AddLog(std::string log_msg, T... tag)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			LogRecord& record = Push();
+			record.message = LM_CUSTOM;
+			record.entity = NULL_ID;
+			record.type = NULL_ID;
+			record.type_name = nullptr;
+			customs[(head + MAX_LOG - 1) % MAX_LOG] = std::move(log_msg);
+			Tag(record, tag...);
 		}
 
 		// get the previous n amount of log in string
 		// default n = max number of log
 		std::string GetLogs(std::size_t n = MAX_LOG)
 		{
+			std::lock_guard<std::mutex> lock(mutex);
+
 			std::string log_msg = "";
-			std::size_t begin = n > logs.size() ? logs.size() : n;
+			std::size_t begin = n > count ? count : n;
 			for (std::size_t i = begin; i >= 1; --i)
 			{
-				log_msg += logs.at(i - 1).second + "\n";
+				log_msg += Format(Index(i - 1)) + "\n";
 			}
 			return log_msg;
 		}
@@ -87,15 +314,31 @@ namespace lecs
 		// get the lattest log
 		std::string GetLog()
 		{
-			return logs.front().second;
+			std::lock_guard<std::mutex> lock(mutex);
+			if (count == 0) return "";
+			return Format(Index(0));
 		}
 
 		// get the lattest log with tag
 		std::string GetLog(LogTag tag)
 		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (has_tag[tag]) return Format(last_per_tag[tag]);
 			return log_per_tag[tag];
 		}
 
+		// get the number of records stored
+		std::size_t Size() const
+		{
+			return count;
+		}
+
+		// get the nth lattest record
+		const LogRecord& GetRecord(std::size_t n = 0) const
+		{
+			return records[Index(n)];
+		}
+
 		// toggle to turn on or off always output new log to console
 		void AlwaysShow(bool always = true)
 		{
@@ -117,579 +360,6361 @@ namespace lecs
 		static const std::size_t n_tag = LT_SIZE;
 
 		std::bitset<n_tag> show;
-		std::deque<std::pair<std::bitset<n_tag>, std::string>> logs;
+
+		std::array<LogRecord, MAX_LOG> records;
+		std::array<std::string, MAX_LOG> customs;
+		std::size_t head = 0;
+		std::size_t count = 0;
+
+		// index of the lattest record of each tag, if it is still in the ring buffer
+		std::array<std::size_t, n_tag> last_per_tag;
+		std::array<bool, n_tag> has_tag{};
+
+		// lattest log of each tag in string, made when its record is overwritten
 		std::array<std::string, n_tag> log_per_tag;
-	};
 
-	// the logger used in namespace lecs
-	static Logger logger;
+		std::chrono::steady_clock::time_point epoch;
 
-	// base class for all components
-	class Component
-	{
-	public:
+		std::mutex mutex;
 
-		// the next component id to be assigned
-		static uint32_t NextComponentID()
+		// get the index in ring buffer of the nth lattest record
+		std::size_t Index(std::size_t n) const
 		{
-			static uint32_t next_component_id = 0;
-			return next_component_id++;
+			return (head + MAX_LOG - 1 - n) % MAX_LOG;
 		}
 
-		// get the component id of component T
-		// create a new component id if the component type is never assigned an id before
-		template <typename T>
-		static uint32_t GetComponentTypeID()
+		// get a new record in the ring buffer, overwriting the oldest one if full
+		LogRecord& Push()
 		{
-			static uint32_t id = NextComponentID();
+			LogRecord& record = records[head];
+			if (count == MAX_LOG)
+			{
+				for (std::size_t t = 0; t < n_tag; ++t)
+				{
+					if (!record.tags[t] || !has_tag[t] || last_per_tag[t] != head) continue;
+					log_per_tag[t] = Format(head);
+					has_tag[t] = false;
+				}
+			}
 
-			if (id > MAX_COMPONENT) logger.AddLog
-			(
-				"Error: new component id for Component " + std::string(typeid(T).name()) + " exceed MAX_COMPONENT",
-				LT_ERROR
-			);
+			record.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+			record.tags.reset();
+			customs[head].clear();
 
-			return id;
+			head = (head + 1) % MAX_LOG;
+			if (count < MAX_LOG) ++count;
+			return record;
 		}
 
-		// store the id of the entity this component belongs to
-		uint32_t entity;
-	};
+		// set tags of the lattest record and output it if shown
+		template <typename... T>
+		void Tag(LogRecord& record, T... tag)
+		{
+			LogTag tags[] = { tag... };
+			for (auto t : tags)
+			{
+				record.tags[t] = true;
+				last_per_tag[t] = Index(0);
+				has_tag[t] = true;
+			}
 
-	class EntityManager;
+			if ((record.tags & show).any()) std::cout << Format(Index(0)) << std::endl;
+		}
 
-	// groups name
-	// or you can use normal int
-	enum EntityGroup
-	{
-		GRP_ENTITY,
-		GRP_TERRAIN,
+		// make the string of the record at index of ring buffer
+		std::string Format(std::size_t index) const
+		{
+			const LogRecord& r = records[index];
+			std::string name = r.type_name ? r.type_name : "";
+			std::string entity = std::to_string(r.entity);
 
-		GRP_SIZE
+			switch (r.message)
+			{
+			case LM_COMPONENT_ADDED:
+				return "New component added to entity: Component " + name + " added to Entity " + entity;
+			case LM_COMPONENT_REMOVED:
+				return "Component removed from entity: Component " + name + " removed from Entity " + entity;
+			case LM_COMPONENT_MISSING:
+				return "Warning: Entity " + entity + " does not have Component " + name + ", returned nullptr";
+			case LM_COMPONENT_NOT_REMOVED:
+				return "Warning: Entity " + entity + " does not have Component " + name + ", nothing removed";
+			case LM_ENTITY_CREATED:
+				return "Entity created: Entity " + entity + " created";
+			case LM_ENTITY_DESTROYED:
+				return "Entity destroyed: Entity " + entity + " destroyed";
+			case LM_ENTITIES_SPAWNED:
+				return "Entities spawned: Entity " + entity + " to Entity " + std::to_string(r.entity + r.type - 1) + " spawned";
+			case LM_ENTITIES_COMPACTED:
+				return "Entities compacted: " + entity + " entity ids compacted into " + std::to_string(r.type) + " ids";
+			case LM_ENTITY_NULL:
+				return "Error: Entity " + entity + " is nullptr";
+			case LM_EVENT_CREATED:
+				return "Event created: Event " + name + " created";
+			case LM_EVENT_EMITTED:
+				return "Event emitted: Event " + name + " emitted";
+			case LM_SYSTEM_CREATED:
+				return "System created: System " + name + " created";
+			case LM_SYSTEM_MISSING:
+				return "Warning: " + name + " does not exist, returned nullptr";
+			default:
+				return customs[index];
+			}
+		}
 	};
 
-	// entity class to store its own components and id
-	class Entity
-	{
-	private:
+	// copy construct the component at dst from src
+	typedef void (*CopyFunction)(void* dst, const void* src);
 
-		EntityManager& entity_manager;
-		bool active = true;
+	class SparsePoolBase;
+	template <typename T> class SparsePool;
 
-		std::array<std::unique_ptr<Component>, MAX_COMPONENT> components;
-		std::bitset<MAX_COMPONENT> component_bitset;
+	// create an empty sparse set pool
+	typedef SparsePoolBase* (*PoolFunction)();
 
-		const static std::size_t n_group = GRP_SIZE;
-		std::bitset<n_group> group_bitset;
+	// type erased informations of a component type
+	// used by archetypes to manage components stored in chunks
+	struct ComponentInfo
+	{
+		std::size_t size;
+		std::size_t align;
+		const char* name;
 
-	public:
+		// whether the component can be copied with memcpy
+		bool trivial;
 
-		// entity id
-		uint32_t id;
+		// copy construct the component at dst from src, null if the component can not be copied
+		CopyFunction copy;
 
-		Entity(EntityManager& entity_manager, uint32_t id) : entity_manager(entity_manager), id(id) {}
+		// move construct the component at dst from src, then destroy src
+		void (*move)(void* dst, void* src);
 
-		// check if the entity is active
-		bool IsActive()
-		{
-			return active;
-		}
+		// destroy the component at ptr
+		void (*destroy)(void* ptr);
 
-		// destroy the entity
-		// immediate = false, destroy until the next update of entity manager
-		void Destroy(bool immediate = false);
+		// set the id of the entity the component at ptr belongs to
+		void (*set_entity)(void* ptr, uint32_t entity);
 
-		// add component T to this entity
-		// pass in unique_ptr type
-		template <typename T>
-		T& AddComponent(std::unique_ptr<T> u_ptr)
-		{
-			u_ptr->entity = id;
+		// whether the component is stored in a sparse set pool instead of archetypes
+		bool sparse;
 
-			components[Component::GetComponentTypeID<T>()] = std::move(u_ptr);
-			component_bitset[Component::GetComponentTypeID<T>()] = true;
+		// create an empty sparse set pool of the component, null for components not stored in sparse set pools
+		PoolFunction new_pool;
+	};
 
-			logger.AddLog
-			(
-				"New component added to entity: Component " + std::string(typeid(T).name()) + " added to Entity " + std::to_string(id),
-				LT_COMPONENT, LT_CREATE
-			);
-			return *u_ptr.get();
-		}
+	class SparseComponent;
 
-		// pass in component
-		template <typename T>
-		T& AddComponent(const T& c)
-		{
-			c->entity = id;
-			std::unique_ptr<Component> u_ptr{ c };
+	// check whether component T is stored in a sparse set pool
+	template <typename T>
+	struct IsSparse : std::integral_constant<bool, std::is_base_of<SparseComponent, T>::value> {};
 
-			components[Component::GetComponentTypeID<T>()] = std::move(u_ptr);
-			component_bitset[Component::GetComponentTypeID<T>()] = true;
+	// base class for all components
+	class Component
+	{
+	public:
 
-			logger.AddLog
-			(
-				"New component added to entity: Component " + std::string(typeid(T).name()) + " added to Entity " + std::to_string(id),
-				LT_COMPONENT, LT_CREATE
-			);
-			return *c;
-		}
+		// store the id of the entity this component belongs to
+		uint32_t entity;
+	};
 
-		// pass in contructor argument of component
-		template <typename T, typename... TArgs>
-		T& AddComponent(TArgs&&... mArgs)
-		{
-			T* c(new T(std::forward<TArgs>(mArgs)...));
-			c->entity = id;
-			std::unique_ptr<Component> u_ptr{ c };
+	// the next type key of family Family
+	template <typename Family>
+	inline uint32_t NextTypeKey()
+	{
+		static std::atomic<uint32_t> next_key{ 0 };
+		return next_key++;
+	}
 
-			components[Component::GetComponentTypeID<T>()] = std::move(u_ptr);
-			component_bitset[Component::GetComponentTypeID<T>()] = true;
+	// get the key of type T in family Family
+	// keys are assigned once on first use and never change, so they can be shared by all worlds
+	// each world maps keys to its own ids
+	template <typename Family, typename T>
+	inline uint32_t GetTypeKey()
+	{
+		static const uint32_t key = NextTypeKey<Family>();
+		return key;
+	}
 
-			logger.AddLog
-			(
-				"New component added to entity: Component " + std::string(typeid(T).name()) + " added to Entity " + std::to_string(id),
-				LT_COMPONENT, LT_CREATE
-			);
-			return *c;
-		}
+	// get the function copying component T, null if T can not be copied
+	template <typename T>
+	inline CopyFunction GetCopyFunction(std::true_type)
+	{
+		return [](void* dst, const void* src)
+		{
+			new (dst) T(*static_cast<const T*>(src));
+		};
+	}
+	template <typename T>
+	inline CopyFunction GetCopyFunction(std::false_type)
+	{
+		return nullptr;
+	}
 
-		// remove component T from this entity
-		template <typename T>
-		T& RemoveComponent()
+	// get the function creating the sparse set pool of component T, null if T is not a sparse component
+	template <typename T>
+	inline PoolFunction GetPoolFunction(std::true_type)
+	{
+		return []() -> SparsePoolBase*
 		{
-			T c = *static_cast<T*>(components[Component::GetComponentTypeID<T>()].get());
-			delete components[Component::GetComponentTypeID<T>()].release();
-			component_bitset[Component::GetComponentTypeID<T>()] = false;
+			return new SparsePool<T>();
+		};
+	}
+	template <typename T>
+	inline PoolFunction GetPoolFunction(std::false_type)
+	{
+		return nullptr;
+	}
 
-			logger.AddLog
-			(
-				"Component removed from entity: Component " + std::string(typeid(T).name()) + " removed from Entity " + std::to_string(id),
-				LT_COMPONENT, LT_DELETE
-			);
-			return c;
-		}
+	// get the informations of component type T
+	template <typename T>
+	inline const ComponentInfo& GetComponentInfoOf()
+	{
+		// chunks of archetypes are only aligned to max_align_t
+		static_assert(IsSparse<T>::value || alignof(T) <= alignof(std::max_align_t), "component is over aligned, make it a sparse component");
 
-		// get component T from this entity
-		template <typename T>
-		T& GetComponent() const
+		static const ComponentInfo info =
 		{
-			auto ptr(components[Component::GetComponentTypeID<T>()].get());
-			if (ptr == nullptr) logger.AddLog
-			(
-				"Warning: Entity " + std::to_string(id) + " does not have Component " + std::string(typeid(T).name()) + ", returned nullptr",
-				LT_WARNING
-			);
-			return *static_cast<T*>(ptr);
-		}
+			sizeof(T), alignof(T), typeid(T).name(),
+			std::is_trivially_copyable<T>::value,
+			GetCopyFunction<T>(std::is_copy_constructible<T>()),
+			[](void* dst, void* src)
+			{
+				T* c = static_cast<T*>(src);
+				new (dst) T(std::move(*c));
+				c->~T();
+			},
+			[](void* ptr)
+			{
+				static_cast<T*>(ptr)->~T();
+			},
+			[](void* ptr, uint32_t entity)
+			{
+				static_cast<T*>(ptr)->entity = entity;
+			},
+			IsSparse<T>::value,
+			GetPoolFunction<T>(IsSparse<T>())
+		};
+		return info;
+	}
 
-		// check whether this entity has component T
-		template <typename T>
-		bool HasComponent()
+	// array which grows by pages that are never moved
+	// elements can be read by any thread while one thread at a time grows the array
+	template <typename T, std::size_t PAGE_SIZE = 256, std::size_t N_PAGE = 256>
+	class PagedArray
+	{
+	private:
+
+		std::array<std::atomic<T*>, N_PAGE> pages;
+
+	public:
+
+		PagedArray()
 		{
-			return component_bitset[Component::GetComponentTypeID<T>()];
+			for (auto& page : pages) page.store(nullptr, std::memory_order_relaxed);
 		}
-
-		// group bitset to true
-		void AddGroup(std::size_t group)
+		~PagedArray()
 		{
-			group_bitset[group] = true;
+			for (auto& page : pages) delete[] page.load(std::memory_order_relaxed);
 		}
+		PagedArray(const PagedArray&) = delete;
+		PagedArray& operator=(const PagedArray&) = delete;
 
-		// set false to group in group bitset
-		void RemoveGroup(std::size_t group)
+		// get the element at index, nullptr if its page is not allocated
+		T* Find(std::size_t index) const
 		{
-			group_bitset[group] = false;
+			if (index / PAGE_SIZE >= N_PAGE) return nullptr;
+			T* page = pages[index / PAGE_SIZE].load(std::memory_order_acquire);
+			return page ? page + index % PAGE_SIZE : nullptr;
 		}
 
-		// check whether this entity has group
-		bool HasGroup(std::size_t group)
+		// get the element at index, allocating its page if needed
+		// page elements are initialized with init
+		// must not be called by more than one thread at a time
+		template <typename F>
+		T& Get(std::size_t index, F init)
 		{
-			return group_bitset[group];
+			if (index / PAGE_SIZE >= N_PAGE) throw std::length_error("lecs: too many types");
+			T* page = pages[index / PAGE_SIZE].load(std::memory_order_acquire);
+			if (!page)
+			{
+				page = new T[PAGE_SIZE];
+				for (std::size_t i = 0; i < PAGE_SIZE; i++) init(page[i]);
+				pages[index / PAGE_SIZE].store(page, std::memory_order_release);
+			}
+			return page[index % PAGE_SIZE];
 		}
 	};
 
-	// entity container class for storing and filtering multiple entities
-	class EntityContainer
+	// component types of a world
+	// assigns dense component ids in the order component types are first used by the world
+	// looking up a registered type never locks and can be done by systems running in parallel
+	class ComponentRegistry
 	{
 	private:
 
-		EntityManager& entity_manager;
+		// component id of each type key, NULL_ID if the type is not registered
+		PagedArray<std::atomic<uint32_t>> ids;
 
-	public:
+		// informations of each component id
+		PagedArray<const ComponentInfo*> infos;
 
-		// a vector of entity that contains the entities this container contains
-		std::vector<Entity*> entities;
+		uint32_t size = 0;
+		std::mutex mutex;
 
-		explicit EntityContainer(EntityManager& entity_manager) : entity_manager(entity_manager) {}
+		template <typename T>
+		uint32_t Register(uint32_t key)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto& id = ids.Get(key, [](std::atomic<uint32_t>& e) { e.store(NULL_ID, std::memory_order_relaxed); });
+			if (id.load(std::memory_order_relaxed) != NULL_ID) return id.load(std::memory_order_relaxed);
 
-		// get an entity container that only contains entities with component T
+			uint32_t cid = size;
+			infos.Get(cid, [](const ComponentInfo*& e) { e = nullptr; }) = &GetComponentInfoOf<T>();
+			size++;
+			id.store(cid, std::memory_order_release);
+			return cid;
+		}
+
+	public:
+
+		// get the component id of component T
+		// create a new component id if the world never used the component type before
 		template <typename T>
-		EntityContainer EntityFilter();
+		uint32_t GetID()
+		{
+			uint32_t key = GetTypeKey<Component, T>();
+			const std::atomic<uint32_t>* id = ids.Find(key);
+			if (id)
+			{
+				uint32_t cid = id->load(std::memory_order_acquire);
+				if (cid != NULL_ID) return cid;
+			}
+			return Register<T>(key);
+		}
+
+		// get the informations of the component type with component id
+		const ComponentInfo& GetInfo(uint32_t cid) const
+		{
+			return **infos.Find(cid);
+		}
+
+		// number of component types registered
+		uint32_t Size() const
+		{
+			return size;
+		}
 	};
 
-	// entity manager class for managing all entities
-	class EntityManager
+	// set of component ids which grows with the number of component types
+	// the first 64 component ids are stored inline, the rest in a vector without trailing zero words
+	class ComponentSignature
 	{
 	private:
 
-		uint32_t next_id;
-
-		static const std::size_t n_group = GRP_SIZE;
-		std::array<EntityContainer*, n_group> groups;
+		uint64_t first = 0;
+		std::vector<uint64_t> rest;
 
 	public:
 
-		// unique_ptr of entities currently active
-		// unsafe to directly get entities through this vector as there will be nullptr
-		std::vector<std::unique_ptr<Entity>> entities;
-
-		// vector of id of destroyed entities to be reused
-		std::vector<uint32_t> empty_id;
+		ComponentSignature() = default;
 
-		EntityManager()
+		// add component id
+		ComponentSignature& Set(uint32_t cid)
 		{
-			for (auto i(0u); i < n_group; ++i)
+			if (cid < 64)
 			{
-				groups[i] = new EntityContainer(*this);
+				first |= uint64_t(1) << cid;
+				return *this;
 			}
+
+			std::size_t word = cid / 64 - 1;
+			if (rest.size() <= word) rest.resize(word + 1, 0);
+			rest[word] |= uint64_t(1) << (cid % 64);
+			return *this;
 		}
 
-		// check and destroy non active entities
+		// remove component id
+		ComponentSignature& Reset(uint32_t cid)
+		{
+			if (cid < 64)
+			{
+				first &= ~(uint64_t(1) << cid);
+				return *this;
+			}
+
+			std::size_t word = cid / 64 - 1;
+			if (word >= rest.size()) return *this;
+			rest[word] &= ~(uint64_t(1) << (cid % 64));
+			while (!rest.empty() && rest.back() == 0) rest.pop_back();
+			return *this;
+		}
+
+		// check whether component id is in the set
+		bool Test(uint32_t cid) const
+		{
+			return (Word(cid / 64) >> (cid % 64)) & 1;
+		}
+
+		// number of 64 bit words needed to store the set
+		std::size_t WordCount() const
+		{
+			return rest.size() + 1;
+		}
+
+		// get 64 bit word i of the set, 0 after the last word
+		uint64_t Word(std::size_t i) const
+		{
+			if (i == 0) return first;
+			return i - 1 < rest.size() ? rest[i - 1] : 0;
+		}
+
+		// check whether the set only has component ids below 64
+		bool IsSmall() const
+		{
+			return rest.empty();
+		}
+
+		bool None() const
+		{
+			return first == 0 && rest.empty();
+		}
+
+		bool Any() const
+		{
+			return !None();
+		}
+
+		// check whether all component ids of other are in this set
+		bool Contains(const ComponentSignature& other) const
+		{
+			if ((first & other.first) != other.first) return false;
+			if (other.rest.size() > rest.size()) return false;
+			for (std::size_t i = 0; i < other.rest.size(); ++i)
+			{
+				if ((rest[i] & other.rest[i]) != other.rest[i]) return false;
+			}
+			return true;
+		}
+
+		// check whether this set and other have any component id in common
+		bool Intersects(const ComponentSignature& other) const
+		{
+			if (first & other.first) return true;
+			std::size_t n = std::min(rest.size(), other.rest.size());
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				if (rest[i] & other.rest[i]) return true;
+			}
+			return false;
+		}
+
+		ComponentSignature& operator|=(const ComponentSignature& other)
+		{
+			first |= other.first;
+			if (rest.size() < other.rest.size()) rest.resize(other.rest.size(), 0);
+			for (std::size_t i = 0; i < other.rest.size(); ++i) rest[i] |= other.rest[i];
+			return *this;
+		}
+
+		bool operator==(const ComponentSignature& other) const
+		{
+			return first == other.first && rest == other.rest;
+		}
+
+		bool operator!=(const ComponentSignature& other) const
+		{
+			return !(*this == other);
+		}
+
+		// call fn(uint32_t) for every component id in ascending order
+		template <typename F>
+		void ForEach(F fn) const
+		{
+			for (std::size_t w = 0; w < WordCount(); ++w)
+			{
+				for (uint64_t bits = Word(w); bits; bits &= bits - 1)
+				{
+					uint32_t bit = 0;
+					while (!((bits >> bit) & 1)) ++bit;
+					fn(static_cast<uint32_t>(w * 64 + bit));
+				}
+			}
+		}
+
+		// hash for unordered containers
+		struct Hash
+		{
+			std::size_t operator()(const ComponentSignature& signature) const
+			{
+				uint64_t h = signature.first * 0x9E3779B97F4A7C15ull;
+				for (auto w : signature.rest) h = (h ^ w) * 0x9E3779B97F4A7C15ull;
+				return static_cast<std::size_t>(h ^ (h >> 32));
+			}
+		};
+	};
+
+	// check whether the n words of row have all bits of all and no bits of none
+	inline bool MatchSignatureWords(const uint64_t* row, const uint64_t* all, const uint64_t* none, std::size_t n)
+	{
+		std::size_t i = 0;
+#ifdef LECS_SSE2
+		__m128i miss = _mm_setzero_si128();
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(all + i));
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(none + i));
+			miss = _mm_or_si128(miss, _mm_andnot_si128(r, a));
+			miss = _mm_or_si128(miss, _mm_and_si128(r, x));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(miss, _mm_setzero_si128())) != 0xFFFF) return false;
+#endif
+		for (; i < n; ++i)
+		{
+			if ((row[i] & all[i]) != all[i] || (row[i] & none[i])) return false;
+		}
+		return true;
+	}
+
+	// statistics of a pool
+	struct PoolStats
+	{
+		std::string name;
+
+		// size in bytes of each block or object
+		std::size_t block_size;
+
+		// number of slabs allocated
+		std::size_t slabs;
+
+		// number of blocks in use and free to be reused
+		std::size_t used;
+		std::size_t free;
+	};
+
+	// slab allocator class for blocks of a fixed size
+	// blocks are carved from slabs and recycled through a free list, slabs are freed with the pool or by Trim
+	class SlabPool
+	{
+	private:
+
+		std::size_t block_size;
+		std::size_t slab_size;
+
+		std::vector<std::unique_ptr<uint8_t[]>> slabs;
+
+		// free blocks, each free block stores the pointer to the next one
+		void* free_list = nullptr;
+
+		std::size_t n_used = 0;
+		std::size_t n_free = 0;
+
+		// allocate a slab and add its blocks to the free list
+		void AddSlab()
+		{
+			slabs.emplace_back(new uint8_t[block_size * slab_size]);
+			LECS_PROFILE_ALLOCATION();
+			uint8_t* slab = slabs.back().get();
+
+			// push in reverse so that blocks are handed out in address order
+			for (std::size_t i = slab_size; i-- > 0;)
+			{
+				void* block = slab + i * block_size;
+				*static_cast<void**>(block) = free_list;
+				free_list = block;
+			}
+			n_free += slab_size;
+		}
+
+	public:
+
+		// block_size is rounded up to keep blocks aligned
+		SlabPool(std::size_t block_size, std::size_t slab_size)
+			: block_size((std::max(block_size, sizeof(void*)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+			slab_size(slab_size) {}
+
+		SlabPool(const SlabPool&) = delete;
+		SlabPool& operator=(const SlabPool&) = delete;
+
+		// get a block
+		void* Allocate()
+		{
+			if (free_list == nullptr) AddSlab();
+
+			void* block = free_list;
+			free_list = *static_cast<void**>(block);
+			--n_free;
+			++n_used;
+			return block;
+		}
+
+		// return a block to the pool
+		void Deallocate(void* block)
+		{
+			*static_cast<void**>(block) = free_list;
+			free_list = block;
+			++n_free;
+			--n_used;
+		}
+
+		// size in bytes of each block
+		std::size_t BlockSize() const
+		{
+			return block_size;
+		}
+
+		// get the statistics of this pool
+		PoolStats GetStats(std::string name) const
+		{
+			return PoolStats{ std::move(name), block_size, slabs.size(), n_used, n_free };
+		}
+
+		// exchange the blocks of this pool with the blocks of other
+		// both pools must have the same block size
+		void Swap(SlabPool& other)
+		{
+			slabs.swap(other.slabs);
+			std::swap(free_list, other.free_list);
+			std::swap(n_used, other.n_used);
+			std::swap(n_free, other.n_free);
+		}
+
+		// release the slabs whose blocks are all free
+		// the free list is rebuilt in address order
+		void Trim()
+		{
+			std::vector<uint8_t*> free_blocks;
+			free_blocks.reserve(n_free);
+			for (void* block = free_list; block; block = *static_cast<void**>(block))
+			{
+				free_blocks.push_back(static_cast<uint8_t*>(block));
+			}
+			std::sort(free_blocks.begin(), free_blocks.end());
+
+			std::sort(slabs.begin(), slabs.end(),
+				[](const std::unique_ptr<uint8_t[]>& a, const std::unique_ptr<uint8_t[]>& b)
+				{
+					return a.get() < b.get();
+				});
+
+			// free blocks of each slab are contiguous in the sorted free blocks
+			std::vector<uint8_t*> kept;
+			std::size_t b = 0, kept_slabs = 0;
+			for (std::size_t i = 0; i < slabs.size(); ++i)
+			{
+				uint8_t* begin = slabs[i].get();
+				uint8_t* end = begin + block_size * slab_size;
+				std::size_t first = b;
+				while (b < free_blocks.size() && free_blocks[b] < end) ++b;
+
+				if (b - first == slab_size)
+				{
+					slabs[i].reset();
+					n_free -= slab_size;
+					continue;
+				}
+				kept.insert(kept.end(), free_blocks.begin() + first, free_blocks.begin() + b);
+				slabs[kept_slabs++] = std::move(slabs[i]);
+			}
+			slabs.resize(kept_slabs);
+
+			free_list = nullptr;
+			for (std::size_t i = kept.size(); i-- > 0;)
+			{
+				*reinterpret_cast<void**>(kept[i]) = free_list;
+				free_list = kept[i];
+			}
+		}
+	};
+
+	// object pool class to construct objects of T in slabs
+	template <typename T>
+	class ObjectPool
+	{
+	private:
+
+		static_assert(alignof(T) <= alignof(std::max_align_t), "object is over aligned");
+
+		SlabPool slab_pool;
+
+	public:
+
+		explicit ObjectPool(std::size_t slab_size) : slab_pool(sizeof(T), slab_size) {}
+
+		// construct an object with arguments
+		template <typename... TArgs>
+		T* New(TArgs&&... args)
+		{
+			return new (slab_pool.Allocate()) T(std::forward<TArgs>(args)...);
+		}
+
+		// destroy an object and return its memory to the pool
+		void Delete(T* ptr)
+		{
+			ptr->~T();
+			slab_pool.Deallocate(ptr);
+		}
+
+		// get the statistics of this pool
+		PoolStats GetStats(std::string name) const
+		{
+			return slab_pool.GetStats(std::move(name));
+		}
+
+		// exchange the objects of this pool with the objects of other
+		void Swap(ObjectPool& other)
+		{
+			slab_pool.Swap(other.slab_pool);
+		}
+
+		// release the slabs without objects
+		void Trim()
+		{
+			slab_pool.Trim();
+		}
+	};
+
+	// base class for components stored in a sparse set pool instead of archetypes
+	// adding or removing it does not move the other components of the entity
+	// use it for components added and removed often
+	class SparseComponent : public Component {};
+
+	// saved state of a sparse set pool, shared between snapshots while the pool is unchanged
+	struct SparsePoolState
+	{
+		virtual ~SparsePoolState() = default;
+
+		std::vector<uint32_t> sparse;
+		std::vector<uint32_t> owners;
+		std::vector<uint32_t> added_ticks;
+		std::vector<uint32_t> changed_ticks;
+	};
+
+	// base class of sparse set pools
+	class SparsePoolBase
+	{
+	protected:
+
+		// index in the dense array of each entity id, NULL_ID if the entity does not have the component
+		std::vector<uint32_t> sparse;
+
+		// entity id of each component in the dense array
+		std::vector<uint32_t> owners;
+
+		// tick each component was added and last changed, parallel to the dense array
+		std::vector<uint32_t> added_ticks;
+		std::vector<uint32_t> changed_ticks;
+
+		// increased when a component is added, removed or moved
+		uint32_t version = 0;
+
+		// state last saved or restored, with the version and the write tick at that time
+		// the pool is unchanged since if the version is the same and no component changed at or after the tick
+		std::shared_ptr<const SparsePoolState> synced;
+		uint32_t sync_version = 0;
+		uint32_t sync_tick = 0;
+
+		bool ChangedSinceSync() const
+		{
+			return !synced || version != sync_version || HasTickSince(changed_ticks.data(), changed_ticks.size(), sync_tick);
+		}
+
+		// copy the pool into a new state, or restore the pool from state
+		virtual std::shared_ptr<const SparsePoolState> SaveState() const = 0;
+		virtual void RestoreState(const SparsePoolState& state) = 0;
+
+		// write the owner of the component at index into the component
+		virtual void SetEntity(uint32_t index) = 0;
+
+	public:
+
+		virtual ~SparsePoolBase() = default;
+
+		// get the tick the component of entity was added and last changed
+		uint32_t& AddedTick(uint32_t entity)
+		{
+			return added_ticks[sparse[entity]];
+		}
+		uint32_t& ChangedTick(uint32_t entity)
+		{
+			return changed_ticks[sparse[entity]];
+		}
+
+		// check whether entity has the component
+		bool Has(uint32_t entity) const
+		{
+			return entity < sparse.size() && sparse[entity] != NULL_ID;
+		}
+
+		// number of components stored
+		std::size_t Size() const
+		{
+			return owners.size();
+		}
+
+		// get the array of entity id of each component
+		const uint32_t* Entities() const
+		{
+			return owners.data();
+		}
+
+		// remove the component of entity
+		virtual void Remove(uint32_t entity) = 0;
+
+		// get the statistics of this pool
+		virtual PoolStats GetStats() const = 0;
+
+		// move the component of entity from to entity to, which must not have the component
+		void Rename(uint32_t from, uint32_t to)
+		{
+			++version;
+			uint32_t index = sparse[from];
+			sparse[from] = NULL_ID;
+			if (sparse.size() <= to) sparse.resize(to + 1, NULL_ID);
+			sparse[to] = index;
+			owners[index] = to;
+			SetEntity(index);
+		}
+
+		// change the id of each entity with the component to remap[id]
+		// n_entity is the number of entity ids after remapping
+		void Remap(const std::vector<uint32_t>& remap, std::size_t n_entity)
+		{
+			++version;
+			std::vector<uint32_t> remapped(n_entity, NULL_ID);
+			for (std::size_t i = 0; i < owners.size(); ++i)
+			{
+				owners[i] = remap[owners[i]];
+				remapped[owners[i]] = static_cast<uint32_t>(i);
+				SetEntity(static_cast<uint32_t>(i));
+			}
+			sparse.swap(remapped);
+		}
+
+		// save the components of the pool
+		// the state last saved or restored is returned if the pool is unchanged since
+		// tick is the write tick now
+		std::shared_ptr<const SparsePoolState> Save(uint32_t tick)
+		{
+			if (ChangedSinceSync())
+			{
+				synced = SaveState();
+				sync_version = version;
+			}
+			sync_tick = tick;
+			return synced;
+		}
+
+		// restore the components of the pool to state
+		// nothing is copied if state is the state last saved or restored and the pool is unchanged since
+		void Restore(const std::shared_ptr<const SparsePoolState>& state, uint32_t tick)
+		{
+			if (state != synced || ChangedSinceSync())
+			{
+				RestoreState(*state);
+				synced = state;
+			}
+			sync_version = version;
+			sync_tick = tick;
+		}
+
+		// remove all components
+		virtual void Clear() = 0;
+
+		// get the dense array of components
+		virtual const void* DenseData() const = 0;
+
+		// add the components of n entities owners, copied from data with memcpy
+		// the components must be trivially copyable, and data holds n components one after another
+		// tick is the tick the components are added and changed
+		virtual void Load(const uint32_t* entities, const uint8_t* data, std::size_t n, uint32_t tick) = 0;
+	};
+
+	// sparse set pool class to store component T
+	// components are stored by value in a dense array, indexed by entity id through a sparse array
+	// removing a component moves the last component into the hole
+	template <typename T>
+	class SparsePool : public SparsePoolBase
+	{
+	private:
+
+		std::vector<T> dense;
+
+		// saved state with a copy of the dense array
+		struct State : SparsePoolState
+		{
+			std::vector<T> dense;
+		};
+
+		void SetEntity(uint32_t index) override
+		{
+			dense[index].entity = owners[index];
+		}
+
+		std::shared_ptr<const SparsePoolState> SaveState() const override
+		{
+			return SaveState(std::is_copy_constructible<T>());
+		}
+
+		std::shared_ptr<const SparsePoolState> SaveState(std::true_type) const
+		{
+			std::shared_ptr<State> state = std::make_shared<State>();
+			state->sparse = sparse;
+			state->owners = owners;
+			state->added_ticks = added_ticks;
+			state->changed_ticks = changed_ticks;
+			state->dense = dense;
+			return state;
+		}
+
+		std::shared_ptr<const SparsePoolState> SaveState(std::false_type) const
+		{
+			throw std::logic_error("lecs: component can not be copied");
+		}
+
+		void RestoreState(const SparsePoolState& state) override
+		{
+			RestoreState(static_cast<const State&>(state), std::is_copy_constructible<T>());
+		}
+
+		void RestoreState(const State& state, std::true_type)
+		{
+			sparse = state.sparse;
+			owners = state.owners;
+			added_ticks = state.added_ticks;
+			changed_ticks = state.changed_ticks;
+
+			// copy constructed so that components only need to be copy constructible
+			dense.clear();
+			dense.reserve(state.dense.size());
+			for (const auto& c : state.dense) dense.push_back(c);
+			++version;
+		}
+
+		void RestoreState(const State&, std::false_type)
+		{
+			throw std::logic_error("lecs: component can not be copied");
+		}
+
+	public:
+
+		// add component T to entity, or replace it if entity already has T
+		template <typename... TArgs>
+		T& Emplace(uint32_t entity, TArgs&&... args)
+		{
+			++version;
+			if (Has(entity))
+			{
+				// constructed first, as args may refer to the component replaced
+				T component(std::forward<TArgs>(args)...);
+				T* c = &dense[sparse[entity]];
+				c->~T();
+				return *new (c) T(std::move(component));
+			}
+
+			if (sparse.size() <= entity) sparse.resize(entity + 1, NULL_ID);
+			sparse[entity] = static_cast<uint32_t>(dense.size());
+			dense.emplace_back(std::forward<TArgs>(args)...);
+			owners.push_back(entity);
+			added_ticks.push_back(0);
+			changed_ticks.push_back(0);
+			return dense.back();
+		}
+
+		// remove the component of entity
+		void Remove(uint32_t entity) override
+		{
+			++version;
+			uint32_t index = sparse[entity];
+			uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+			if (index != last)
+			{
+				dense[index].~T();
+				new (&dense[index]) T(std::move(dense[last]));
+				owners[index] = owners[last];
+				added_ticks[index] = added_ticks[last];
+				changed_ticks[index] = changed_ticks[last];
+				sparse[owners[index]] = index;
+			}
+
+			dense.pop_back();
+			owners.pop_back();
+			added_ticks.pop_back();
+			changed_ticks.pop_back();
+			sparse[entity] = NULL_ID;
+		}
+
+		// get the component of entity
+		T& Get(uint32_t entity)
+		{
+			return dense[sparse[entity]];
+		}
+
+		const void* DenseData() const override
+		{
+			return dense.data();
+		}
+
+		void Load(const uint32_t* entities, const uint8_t* data, std::size_t n, uint32_t tick) override
+		{
+			Load(entities, data, n, tick, std::is_trivially_copyable<T>());
+		}
+
+		void Load(const uint32_t* entities, const uint8_t* data, std::size_t n, uint32_t tick, std::true_type)
+		{
+			++version;
+			dense.reserve(dense.size() + n);
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				// data may not be aligned for T
+				typename std::aligned_storage<sizeof(T), alignof(T)>::type c;
+				std::memcpy(&c, data + sizeof(T) * i, sizeof(T));
+
+				uint32_t entity = entities[i];
+				if (sparse.size() <= entity) sparse.resize(entity + 1, NULL_ID);
+				sparse[entity] = static_cast<uint32_t>(dense.size());
+				dense.push_back(*reinterpret_cast<const T*>(&c));
+				owners.push_back(entity);
+				added_ticks.push_back(tick);
+				changed_ticks.push_back(tick);
+			}
+		}
+
+		void Load(const uint32_t*, const uint8_t*, std::size_t, uint32_t, std::false_type)
+		{
+			throw std::logic_error("lecs: component can not be serialized");
+		}
+
+		// remove all components
+		void Clear() override
+		{
+			++version;
+			sparse.clear();
+			owners.clear();
+			added_ticks.clear();
+			changed_ticks.clear();
+			dense.clear();
+			synced.reset();
+		}
+
+		// get the statistics of this pool
+		// the dense array counts as one slab
+		PoolStats GetStats() const override
+		{
+			return PoolStats{ typeid(T).name(), sizeof(T), dense.capacity() ? 1u : 0u, dense.size(), dense.capacity() - dense.size() };
+		}
+
+		// get the dense array of components
+		T* Data()
+		{
+			return dense.data();
+		}
+
+		// call fn(uint32_t entity, T&) for every component in the pool
+		template <typename F>
+		void ForEach(F fn)
+		{
+			for (std::size_t i = 0; i < dense.size(); ++i)
+			{
+				fn(owners[i], dense[i]);
+			}
+		}
+
+		// begin and end methods for iterating components
+		typename std::vector<T>::iterator begin()
+		{
+			return dense.begin();
+		}
+		typename std::vector<T>::iterator end()
+		{
+			return dense.end();
+		}
+	};
+
+	class Entity;
+	class EntityManager;
+	struct EntityDeleter;
+
+	// saved components of a column of an archetype, shared between snapshots while the column is unchanged
+	struct ColumnState
+	{
+		const ComponentInfo* info;
+
+		// number of components constructed in data
+		std::size_t count = 0;
+		std::unique_ptr<uint8_t[]> data;
+
+		std::vector<uint32_t> added_ticks;
+		std::vector<uint32_t> changed_ticks;
+
+		explicit ColumnState(const ComponentInfo* info) : info(info) {}
+
+		~ColumnState()
+		{
+			if (info->trivial) return;
+			for (std::size_t i = 0; i < count; ++i) info->destroy(data.get() + info->size * i);
+		}
+
+		ColumnState(const ColumnState&) = delete;
+		ColumnState& operator=(const ColumnState&) = delete;
+	};
+
+	// saved rows of an archetype
+	struct ArchetypeState
+	{
+		// entity id of each row, shared while the rows are unchanged
+		std::shared_ptr<const std::vector<uint32_t>> ids;
+
+		std::vector<std::shared_ptr<const ColumnState>> columns;
+	};
+
+	// archetype class to store the components of all entities with the same set of components
+	// components are stored in chunks of CHUNK_SIZE bytes
+	// each chunk holds a contiguous array per component type, plus an array of the entities
+	class Archetype
+	{
+	private:
+
+		friend class EntityManager;
+
+		// column index of each component id, -1 if the component is not stored
+		std::vector<int32_t> columns;
+
+		// component types of the world owning this archetype
+		ComponentRegistry& registry;
+
+		// informations of the component type of each column
+		std::vector<const ComponentInfo*> infos;
+
+		// byte offset of each column in a chunk
+		// offsets[0] is the array of entities
+		std::vector<std::size_t> offsets;
+
+		// number of entities a chunk can store
+		std::size_t capacity;
+
+		// size in bytes of a chunk
+		std::size_t chunk_bytes;
+
+		// number of entities stored
+		std::size_t size = 0;
+
+		std::vector<uint8_t*> chunks;
+
+		// pool allocating chunks of CHUNK_SIZE bytes
+		// chunks of archetypes with rows larger than CHUNK_SIZE are allocated separately
+		SlabPool& chunk_pool;
+
+		uint8_t* AllocateChunk()
+		{
+			if (chunk_bytes <= chunk_pool.BlockSize()) return static_cast<uint8_t*>(chunk_pool.Allocate());
+			LECS_PROFILE_ALLOCATION();
+			return new uint8_t[chunk_bytes];
+		}
+
+		void DeallocateChunk(uint8_t* chunk)
+		{
+			if (chunk_bytes <= chunk_pool.BlockSize()) chunk_pool.Deallocate(chunk);
+			else delete[] chunk;
+		}
+
+		// tick each component was added and last changed, indexed by column and row
+		std::vector<std::vector<uint32_t>> added_ticks;
+		std::vector<std::vector<uint32_t>> changed_ticks;
+
+		// cached archetype to move to when a component is added or removed
+		// indexed by component id, grown when needed
+		std::vector<Archetype*> add_edges;
+		std::vector<Archetype*> remove_edges;
+
+		// increased when rows are added, removed or moved
+		uint32_t version = 0;
+
+		// state last saved or restored, with the version and the write tick at that time
+		// a column is unchanged since if the version is the same and no component of the column changed at or after the tick
+		std::shared_ptr<const ArchetypeState> synced;
+		uint32_t sync_version = 0;
+		uint32_t sync_tick = 0;
+
+		// check whether the components of column changed since the last save or restore
+		// the rows must be unchanged
+		bool ColumnChangedSinceSync(std::size_t column) const
+		{
+			return HasTickSince(changed_ticks[column].data(), size, sync_tick);
+		}
+
+		// copy the components and ticks of column
+		std::shared_ptr<const ColumnState> SaveColumn(std::size_t column) const;
+
+		// copy the components and ticks of column from state
+		// constructed is whether the components of the column are constructed and need to be destroyed first
+		void RestoreColumn(std::size_t column, const ColumnState& state, bool constructed);
+
+		// destroy all components and remove all rows
+		void Clear();
+
+		// save the rows of this archetype
+		// the state last saved or restored is returned if the archetype is unchanged since, unchanged columns are shared
+		// tick is the write tick now
+		std::shared_ptr<const ArchetypeState> Save(uint32_t tick);
+
+		// restore the rows of this archetype to state, entities are the entities of the restored world
+		// columns of state which are the columns last saved or restored and unchanged since are not copied
+		void Restore(const std::shared_ptr<const ArchetypeState>& state, const std::vector<std::unique_ptr<Entity, EntityDeleter>>& entities, uint32_t tick);
+
+		// call fn with the entities and component arrays of a chunk
+		template <typename F, typename... Ts>
+		static void ForEachInChunk(F& fn, std::size_t n, Entity** entities, Ts*... components)
+		{
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				fn(*entities[i], components[i]...);
+			}
+		}
+
+		// add n rows at the end, entities and components of the rows are not set
+		// return the first row
+		uint32_t AllocateRows(std::size_t n)
+		{
+			++version;
+			while (size + n > chunks.size() * capacity)
+			{
+				chunks.push_back(AllocateChunk());
+			}
+
+			uint32_t first = static_cast<uint32_t>(size);
+			size += n;
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				added_ticks[i].resize(size, 0);
+				changed_ticks[i].resize(size, 0);
+			}
+			return first;
+		}
+
+		// add a row for entity at the end, components of the row are not constructed
+		// return the row
+		uint32_t Allocate(Entity* entity)
+		{
+			++version;
+			if (size == chunks.size() * capacity)
+			{
+				chunks.push_back(AllocateChunk());
+			}
+
+			uint32_t row = static_cast<uint32_t>(size++);
+			Entities(row / capacity)[row % capacity] = entity;
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				added_ticks[i].push_back(0);
+				changed_ticks[i].push_back(0);
+			}
+			return row;
+		}
+
+		// remove a row whose components are already moved out or destroyed
+		// the last row is moved into the hole
+		void Release(uint32_t row);
+
+		// move the rows into new chunks sorted by entity id, and set the entity id of every component
+		// old chunks are returned to old_pool, which is the chunk pool unless it was swapped
+		void SortRows(SlabPool& old_pool);
+
+		// destroy the components of a row and remove it
+		void Remove(uint32_t row)
+		{
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				infos[i]->destroy(Get(types[i], row));
+			}
+			Release(row);
+		}
+
+	public:
+
+		// the set of components of the entities in this archetype
+		ComponentSignature signature;
+
+		// component ids of the components stored, in ascending order
+		std::vector<uint32_t> types;
+
+		Archetype(const ComponentSignature& signature, ComponentRegistry& registry, SlabPool& chunk_pool) :
+			registry(registry), chunk_pool(chunk_pool), signature(signature)
+		{
+			std::size_t row_bytes = sizeof(Entity*);
+			signature.ForEach([this, &row_bytes](uint32_t cid)
+			{
+				types.push_back(cid);
+				infos.push_back(&this->registry.GetInfo(cid));
+				row_bytes += infos.back()->size;
+			});
+
+			columns.assign(types.empty() ? 0 : types.back() + 1, -1);
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				columns[types[i]] = static_cast<int32_t>(i);
+			}
+			added_ticks.resize(types.size());
+			changed_ticks.resize(types.size());
+
+			// find the largest capacity whose columns fit in a chunk after alignment
+			capacity = std::max<std::size_t>(1, CHUNK_SIZE / row_bytes);
+			while (true)
+			{
+				offsets.assign(1, 0);
+				std::size_t bytes = sizeof(Entity*) * capacity;
+				for (auto info : infos)
+				{
+					bytes = (bytes + info->align - 1) / info->align * info->align;
+					offsets.push_back(bytes);
+					bytes += info->size * capacity;
+				}
+
+				if (bytes <= CHUNK_SIZE || capacity == 1)
+				{
+					chunk_bytes = bytes;
+					break;
+				}
+				--capacity;
+			}
+		}
+
+		~Archetype()
+		{
+			for (std::size_t row = 0; row < size; ++row)
+			{
+				for (std::size_t i = 0; i < types.size(); ++i)
+				{
+					infos[i]->destroy(Get(types[i], static_cast<uint32_t>(row)));
+				}
+			}
+
+			for (auto chunk : chunks) DeallocateChunk(chunk);
+		}
+
+		// number of entities stored
+		std::size_t Size() const
+		{
+			return size;
+		}
+
+		// number of entities a chunk can store
+		std::size_t Capacity() const
+		{
+			return capacity;
+		}
+
+		// number of chunks allocated
+		std::size_t ChunkCount() const
+		{
+			return chunks.size();
+		}
+
+		// number of entities stored in chunk
+		std::size_t ChunkSize(std::size_t chunk) const
+		{
+			return std::min(capacity, size - chunk * capacity);
+		}
+
+		// get the entity at row
+		Entity& GetEntity(uint32_t row) const
+		{
+			return *Entities(row / capacity)[row % capacity];
+		}
+
+		// get the array of entities of chunk
+		Entity** Entities(std::size_t chunk) const
+		{
+			return reinterpret_cast<Entity**>(chunks[chunk]);
+		}
+
+		// get the array of component id of chunk
+		void* Column(uint32_t cid, std::size_t chunk) const
+		{
+			return chunks[chunk] + offsets[columns[cid] + 1];
+		}
+
+		// get the array of component T of chunk
+		template <typename T>
+		T* Column(std::size_t chunk) const
+		{
+			return static_cast<T*>(Column(registry.GetID<T>(), chunk));
+		}
+
+		// get the array of the tick each component id was added and last changed, indexed by row
+		uint32_t* AddedTicks(uint32_t cid)
+		{
+			return added_ticks[columns[cid]].data();
+		}
+		uint32_t* ChangedTicks(uint32_t cid)
+		{
+			return changed_ticks[columns[cid]].data();
+		}
+
+		// get the component id of the entity at row
+		void* Get(uint32_t cid, uint32_t row) const
+		{
+			int32_t column = columns[cid];
+			return chunks[row / capacity] + offsets[column + 1] + infos[column]->size * (row % capacity);
+		}
+
+		// call fn(Entity&, Ts&...) for every entity in this archetype
+		// the archetype must store all of Ts...
+		template <typename... Ts, typename F>
+		void ForEach(F& fn)
+		{
+			for (std::size_t chunk = 0; chunk < chunks.size() && chunk * capacity < size; ++chunk)
+			{
+				ForEachInChunk(fn, ChunkSize(chunk), Entities(chunk), Column<Ts>(chunk)...);
+			}
+		}
+
+		// call fn(Entity&, Ts&...) for the entities from row begin to row end - 1
+		// the rows must be in the same chunk
+		template <typename... Ts, typename F>
+		void ForEach(F& fn, uint32_t begin, uint32_t end)
+		{
+			std::size_t chunk = begin / capacity, offset = begin % capacity;
+			ForEachInChunk(fn, end - begin, Entities(chunk) + offset, (Column<Ts>(chunk) + offset)...);
+		}
+	};
+
+	// groups name
+	// or you can use normal int
+	enum EntityGroup
+	{
+		GRP_ENTITY,
+		GRP_TERRAIN,
+
+		GRP_SIZE
+	};
+
+	// handle of an entity through the handle table of entity manager
+	// stays valid when entity ids are changed by compaction, and resolves to nullptr once the entity is destroyed
+	struct EntityHandle
+	{
+		uint32_t slot = NULL_ID;
+		uint32_t generation = 0;
+	};
+
+	// slot of the handle table of entity manager
+	// generation is increased when the entity of the slot is destroyed, so old handles no longer match
+	struct HandleSlot
+	{
+		uint32_t id;
+		uint32_t generation;
+	};
+
+	// order of entity ids after compaction
+	enum CompactOrder
+	{
+		// keep the order of the ids
+		CO_ID,
+
+		// entities with the same signature get contiguous ids, archetype by archetype
+		CO_SIGNATURE,
+
+		// entities of the same group get contiguous ids, entities without group are last
+		CO_GROUP,
+	};
+
+	// entity class to store its id and the location of its components
+	class Entity
+	{
+	private:
+
+		friend class EntityManager;
+		friend class EntityContainer;
+		friend class Archetype;
+		template <typename... Ts> friend class Query;
+
+		EntityManager& entity_manager;
+		bool active = true;
+
+		// archetype storing the components of this entity and the row in it
+		Archetype* archetype = nullptr;
+		uint32_t row = 0;
+
+		const static std::size_t n_group = GRP_SIZE;
+		std::bitset<n_group> group_bitset;
+
+		// index of this entity in each group it is in
+		std::array<uint32_t, n_group> group_index;
+
+		// slot of this entity in the handle table of entity manager
+		uint32_t handle = NULL_ID;
+
+		// logger of the world of this entity
+		Logger& GetLogger() const;
+
+	public:
+
+		// entity id
+		uint32_t id;
+
+		Entity(EntityManager& entity_manager, uint32_t id) : entity_manager(entity_manager), id(id) {}
+
+		// check if the entity is active
+		bool IsActive()
+		{
+			return active;
+		}
+
+		// get the handle of this entity, which stays valid when its id is changed by compaction
+		EntityHandle GetHandle() const;
+
+		// destroy the entity
+		// immediate = false, destroy until the next update of entity manager
+		void Destroy(bool immediate = false);
+
+		// add component T to this entity
+		// pass in unique_ptr type
+		template <typename T>
+		T& AddComponent(std::unique_ptr<T> u_ptr);
+
+		// pass in component
+		template <typename T>
+		T& AddComponent(const T& c);
+
+		// pass in contructor argument of component
+		template <typename T, typename... TArgs>
+		T& AddComponent(TArgs&&... mArgs);
+
+		// remove component T from this entity
+		template <typename T>
+		void RemoveComponent();
+
+		// get component T from this entity
+		// the component is marked changed
+		template <typename T>
+		T& GetComponent() const;
+
+		// get component T from this entity for reading, without marking it changed
+		template <typename T>
+		const T& ReadComponent() const;
+
+		// mark component T of this entity changed
+		template <typename T>
+		void MarkChanged() const;
+
+		// check whether this entity has component T
+		template <typename T>
+		bool HasComponent() const;
+
+		// add this entity to group
+		void AddGroup(std::size_t group);
+
+		// remove this entity from group
+		void RemoveGroup(std::size_t group);
+
+		// check whether this entity has group
+		bool HasGroup(std::size_t group)
+		{
+			return group_bitset[group];
+		}
+	};
+
+	// deleter of entities returning them to the entity pool of entity manager
+	struct EntityDeleter
+	{
+		ObjectPool<Entity>* pool = nullptr;
+
+		void operator()(Entity* entity) const
+		{
+			pool->Delete(entity);
+		}
+	};
+
+	// unique_ptr of entity allocated by entity manager
+	using EntityPtr = std::unique_ptr<Entity, EntityDeleter>;
+
+	// move the rows into new chunks sorted by entity id, and set the entity id of every component
+	inline void Archetype::SortRows(SlabPool& old_pool)
+	{
+		++version;
+		std::vector<uint8_t*> old_chunks;
+		old_chunks.swap(chunks);
+
+		auto old_entity = [this, &old_chunks](uint32_t row)
+		{
+			return reinterpret_cast<Entity**>(old_chunks[row / capacity])[row % capacity];
+		};
+
+		std::vector<uint32_t> rows(size);
+		for (uint32_t row = 0; row < size; ++row) rows[row] = row;
+		std::sort(rows.begin(), rows.end(), [&old_entity](uint32_t a, uint32_t b)
+		{
+			return old_entity(a)->id < old_entity(b)->id;
+		});
+
+		while (chunks.size() * capacity < size)
+		{
+			chunks.push_back(AllocateChunk());
+		}
+
+		for (std::size_t i = 0; i < types.size(); ++i)
+		{
+			std::vector<uint32_t> added(size), changed(size);
+			std::size_t offset = offsets[i + 1], component_size = infos[i]->size;
+			for (uint32_t row = 0; row < size; ++row)
+			{
+				uint32_t src_row = rows[row];
+				void* src = old_chunks[src_row / capacity] + offset + component_size * (src_row % capacity);
+				void* dst = chunks[row / capacity] + offset + component_size * (row % capacity);
+				infos[i]->move(dst, src);
+				infos[i]->set_entity(dst, old_entity(src_row)->id);
+				added[row] = added_ticks[i][src_row];
+				changed[row] = changed_ticks[i][src_row];
+			}
+			added_ticks[i].swap(added);
+			changed_ticks[i].swap(changed);
+		}
+
+		for (uint32_t row = 0; row < size; ++row)
+		{
+			Entity* entity = old_entity(rows[row]);
+			Entities(row / capacity)[row % capacity] = entity;
+			entity->row = row;
+		}
+
+		for (auto chunk : old_chunks)
+		{
+			if (chunk_bytes <= old_pool.BlockSize()) old_pool.Deallocate(chunk);
+			else delete[] chunk;
+		}
+	}
+
+	// remove a row whose components are already moved out or destroyed
+	// the last row is moved into the hole
+	inline void Archetype::Release(uint32_t row)
+	{
+		++version;
+		uint32_t last = static_cast<uint32_t>(size - 1);
+		if (row != last)
+		{
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				infos[i]->move(Get(types[i], row), Get(types[i], last));
+			}
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				added_ticks[i][row] = added_ticks[i][last];
+				changed_ticks[i][row] = changed_ticks[i][last];
+			}
+
+			Entity* moved = Entities(last / capacity)[last % capacity];
+			Entities(row / capacity)[row % capacity] = moved;
+			moved->row = row;
+		}
+		--size;
+		for (std::size_t i = 0; i < types.size(); ++i)
+		{
+			added_ticks[i].pop_back();
+			changed_ticks[i].pop_back();
+		}
+
+		// keep at most one empty chunk to avoid reallocating at chunk boundary
+		while (chunks.size() > 1 && (chunks.size() - 2) * capacity >= size)
+		{
+			DeallocateChunk(chunks.back());
+			chunks.pop_back();
+		}
+	}
+
+	// copy the components and ticks of column
+	inline std::shared_ptr<const ColumnState> Archetype::SaveColumn(std::size_t column) const
+	{
+		const ComponentInfo& info = *infos[column];
+		if (!info.trivial && !info.copy) throw std::logic_error("lecs: component can not be copied");
+
+		std::shared_ptr<ColumnState> state = std::make_shared<ColumnState>(&info);
+		state->data.reset(new uint8_t[info.size * size]);
+		uint8_t* dst = state->data.get();
+		for (std::size_t chunk = 0; chunk * capacity < size; ++chunk)
+		{
+			std::size_t n = ChunkSize(chunk);
+			const uint8_t* src = chunks[chunk] + offsets[column + 1];
+			if (info.trivial)
+			{
+				std::memcpy(dst, src, info.size * n);
+				state->count += n;
+			}
+			else
+			{
+				for (std::size_t i = 0; i < n; ++i, ++state->count)
+				{
+					info.copy(dst + info.size * i, src + info.size * i);
+				}
+			}
+			dst += info.size * n;
+		}
+		state->added_ticks = added_ticks[column];
+		state->changed_ticks = changed_ticks[column];
+		return state;
+	}
+
+	// copy the components and ticks of column from state
+	inline void Archetype::RestoreColumn(std::size_t column, const ColumnState& state, bool constructed)
+	{
+		const ComponentInfo& info = *infos[column];
+		const uint8_t* src = state.data.get();
+		for (std::size_t chunk = 0; chunk * capacity < size; ++chunk)
+		{
+			std::size_t n = ChunkSize(chunk);
+			uint8_t* dst = chunks[chunk] + offsets[column + 1];
+			if (info.trivial)
+			{
+				std::memcpy(dst, src, info.size * n);
+			}
+			else
+			{
+				for (std::size_t i = 0; i < n; ++i)
+				{
+					if (constructed) info.destroy(dst + info.size * i);
+					info.copy(dst + info.size * i, src + info.size * i);
+				}
+			}
+			src += info.size * n;
+		}
+		added_ticks[column] = state.added_ticks;
+		changed_ticks[column] = state.changed_ticks;
+	}
+
+	// destroy all components and remove all rows
+	inline void Archetype::Clear()
+	{
+		++version;
+		for (std::size_t i = 0; i < types.size(); ++i)
+		{
+			if (!infos[i]->trivial)
+			{
+				for (uint32_t row = 0; row < size; ++row) infos[i]->destroy(Get(types[i], row));
+			}
+			added_ticks[i].clear();
+			changed_ticks[i].clear();
+		}
+		size = 0;
+		for (auto chunk : chunks) DeallocateChunk(chunk);
+		chunks.clear();
+		synced.reset();
+	}
+
+	// save the rows of this archetype
+	inline std::shared_ptr<const ArchetypeState> Archetype::Save(uint32_t tick)
+	{
+		bool same_rows = synced && version == sync_version;
+
+		std::vector<bool> changed(types.size(), true);
+		bool any_changed = !same_rows;
+		for (std::size_t i = 0; same_rows && i < types.size(); ++i)
+		{
+			changed[i] = ColumnChangedSinceSync(i);
+			any_changed = any_changed || changed[i];
+		}
+
+		if (any_changed)
+		{
+			std::shared_ptr<ArchetypeState> state = std::make_shared<ArchetypeState>();
+			if (same_rows) state->ids = synced->ids;
+			else
+			{
+				std::shared_ptr<std::vector<uint32_t>> ids = std::make_shared<std::vector<uint32_t>>(size);
+				for (uint32_t row = 0; row < size; ++row) (*ids)[row] = GetEntity(row).id;
+				state->ids = ids;
+			}
+
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				state->columns.push_back(changed[i] ? SaveColumn(i) : synced->columns[i]);
+			}
+			synced = state;
+			sync_version = version;
+		}
+		sync_tick = tick;
+		return synced;
+	}
+
+	// restore the rows of this archetype to state
+	inline void Archetype::Restore(const std::shared_ptr<const ArchetypeState>& state, const std::vector<EntityPtr>& entities, uint32_t tick)
+	{
+		bool same_rows = synced && version == sync_version && synced->ids == state->ids;
+		if (!same_rows)
+		{
+			++version;
+			for (std::size_t i = 0; i < types.size(); ++i)
+			{
+				if (infos[i]->trivial) continue;
+				for (uint32_t row = 0; row < size; ++row) infos[i]->destroy(Get(types[i], row));
+			}
+
+			const auto& ids = *state->ids;
+			std::size_t old_size = size;
+			size = ids.size();
+			std::size_t n_chunk = (size + capacity - 1) / capacity;
+			while (chunks.size() < n_chunk) chunks.push_back(AllocateChunk());
+			while (chunks.size() > n_chunk)
+			{
+				DeallocateChunk(chunks.back());
+				chunks.pop_back();
+			}
+
+			// ticks are restored with the columns
+			// entities already at their row are not touched
+			for (uint32_t row = 0; row < size; ++row)
+			{
+				Entity* e = entities[ids[row]].get();
+				Entity*& slot = Entities(row / capacity)[row % capacity];
+				if (row < old_size && slot == e && e->archetype == this) continue;
+				slot = e;
+				e->archetype = this;
+				e->row = row;
+			}
+		}
+
+		for (std::size_t i = 0; i < types.size(); ++i)
+		{
+			if (same_rows && synced->columns[i] == state->columns[i] && !ColumnChangedSinceSync(i)) continue;
+			RestoreColumn(i, *state->columns[i], same_rows);
+		}
+
+		synced = state;
+		sync_version = version;
+		sync_tick = tick;
+	}
+
+	// types of commands recorded by command buffer
+	enum CommandType : uint8_t
+	{
+		CMD_CREATE,
+		CMD_DESTROY,
+		CMD_ADD_COMPONENT,
+		CMD_REMOVE_COMPONENT,
+	};
+
+	// command buffer class to record entity and component changes to be applied later
+	// submit it to entity manager, it is applied in the next EntityManager::Update
+	// each thread or system can fill its own buffer without locks
+	class CommandBuffer
+	{
+	private:
+
+		friend class EntityManager;
+
+		// header of each command in the byte stream
+		// the component to be added follows the header
+		struct Command
+		{
+			CommandType type;
+
+			// offset in bytes of the component from the start of this command
+			uint16_t payload;
+
+			// bytes from the start of this command to the next command
+			uint32_t size;
+
+			uint32_t entity;
+
+			// informations of the component type added or removed
+			const ComponentInfo* info;
+
+			// add or remove the component of entity, moving out the component in payload
+			void (*apply)(Entity& entity, void* payload);
+		};
+
+		// memory blocks of the byte stream
+		// blocks are never moved so components stored in them stay valid
+		std::vector<std::unique_ptr<uint8_t[]>> blocks;
+		std::vector<std::size_t> capacities;
+		std::vector<std::size_t> used;
+		std::size_t current = 0;
+
+		// number of entities created
+		uint32_t n_created = 0;
+
+		// get space for a command of size bytes at the end of the stream
+		Command* Push(CommandType type, uint32_t entity, std::size_t payload, std::size_t size)
+		{
+			size = (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+			while (current < blocks.size() && used[current] + size > capacities[current])
+			{
+				++current;
+			}
+			if (current == blocks.size())
+			{
+				std::size_t capacity = std::max(COMMAND_BLOCK_SIZE, size);
+				blocks.emplace_back(new uint8_t[capacity]);
+				LECS_PROFILE_ALLOCATION();
+				capacities.push_back(capacity);
+				used.push_back(0);
+			}
+
+			Command* c = reinterpret_cast<Command*>(blocks[current].get() + used[current]);
+			c->type = type;
+			c->payload = static_cast<uint16_t>(payload);
+			c->size = static_cast<uint32_t>(size);
+			c->entity = entity;
+			c->info = nullptr;
+			c->apply = nullptr;
+
+			used[current] += size;
+			return c;
+		}
+
+		// call fn(Command&, void* payload) for every command in recorded order
+		template <typename F>
+		void ForEachCommand(F fn)
+		{
+			for (std::size_t b = 0; b < blocks.size() && b <= current; ++b)
+			{
+				for (std::size_t offset = 0; offset < used[b];)
+				{
+					Command* c = reinterpret_cast<Command*>(blocks[b].get() + offset);
+					fn(*c, reinterpret_cast<uint8_t*>(c) + c->payload);
+					offset += c->size;
+				}
+			}
+		}
+
+		// empty the stream without destroying the components in it
+		// memory blocks are kept for reuse
+		void Reset()
+		{
+			for (auto& u : used) u = 0;
+			current = 0;
+			n_created = 0;
+		}
+
+	public:
+
+		CommandBuffer() = default;
+		CommandBuffer(CommandBuffer&&) = default;
+
+		~CommandBuffer()
+		{
+			Clear();
+		}
+
+		// record creating an entity
+		// return a temporary id to be used in other commands of this buffer
+		uint32_t CreateEntity()
+		{
+			uint32_t id = PENDING_ID | n_created++;
+			Push(CMD_CREATE, id, sizeof(Command), sizeof(Command));
+			return id;
+		}
+
+		// record destroying entity
+		void DestroyEntity(uint32_t entity)
+		{
+			Push(CMD_DESTROY, entity, sizeof(Command), sizeof(Command));
+		}
+
+		// record adding component T to entity
+		// pass in constructor arguments of T, the component is constructed now
+		template <typename T, typename... TArgs>
+		void AddComponent(uint32_t entity, TArgs&&... args)
+		{
+			static_assert(alignof(T) <= alignof(std::max_align_t), "component is over aligned");
+
+			std::size_t payload = (sizeof(Command) + alignof(T) - 1) / alignof(T) * alignof(T);
+			Command* c = Push(CMD_ADD_COMPONENT, entity, payload, payload + sizeof(T));
+			c->info = &GetComponentInfoOf<T>();
+			c->apply = [](Entity& e, void* ptr)
+			{
+				T* component = static_cast<T*>(ptr);
+				e.AddComponent<T>(std::move(*component));
+				component->~T();
+			};
+
+			new (reinterpret_cast<uint8_t*>(c) + payload) T(std::forward<TArgs>(args)...);
+		}
+
+		// record removing component T from entity
+		template <typename T>
+		void RemoveComponent(uint32_t entity)
+		{
+			Command* c = Push(CMD_REMOVE_COMPONENT, entity, sizeof(Command), sizeof(Command));
+			c->info = &GetComponentInfoOf<T>();
+			c->apply = [](Entity& e, void*)
+			{
+				e.RemoveComponent<T>();
+			};
+		}
+
+		// check whether no command is recorded
+		bool Empty() const
+		{
+			return blocks.empty() || (current == 0 && used[0] == 0);
+		}
+
+		// discard all commands recorded
+		void Clear()
+		{
+			ForEachCommand([](Command& c, void* payload)
+			{
+				if (c.type == CMD_ADD_COMPONENT) c.info->destroy(payload);
+			});
+			Reset();
+		}
+	};
+
+	// query filter for entities whose component T changed since the system last ran
+	// use Changed<const T> to only read T
+	template <typename T>
+	struct Changed {};
+
+	// query filter for entities whose component T was added since the system last ran
+	template <typename T>
+	struct Added {};
+
+	// component type of a query parameter and how it is accessed
+	// components accessed through a non-const parameter are marked changed
+	template <typename T>
+	struct QueryTraits
+	{
+		typedef typename std::remove_const<T>::type Component;
+		static constexpr bool changed = false;
+		static constexpr bool added = false;
+		static constexpr bool writes = !std::is_const<T>::value;
+	};
+
+	template <typename T>
+	struct QueryTraits<Changed<T>> : QueryTraits<T>
+	{
+		static constexpr bool changed = true;
+	};
+
+	template <typename T>
+	struct QueryTraits<Added<T>> : QueryTraits<T>
+	{
+		static constexpr bool added = true;
+	};
+
+	// check whether any of the query parameters Ts... is a filter
+	template <typename... Ts>
+	struct HasQueryFilter : std::false_type {};
+
+	template <typename T, typename... Ts>
+	struct HasQueryFilter<T, Ts...> : std::integral_constant<bool,
+		QueryTraits<T>::changed || QueryTraits<T>::added || HasQueryFilter<Ts...>::value> {};
+
+	// persistent list of the archetypes matching a signature
+	// kept up to date by entity manager when new archetypes are created
+	struct QueryData
+	{
+		// all components of the query
+		ComponentSignature signature;
+
+		// components stored in archetypes
+		ComponentSignature table_signature;
+
+		// components stored in sparse set pools
+		std::vector<uint32_t> sparse_types;
+
+		// archetypes with all components of table signature
+		std::vector<Archetype*> archetypes;
+	};
+
+	// rows of an archetype, or indices into a list of entities if archetype is null
+	// run as one job by parallel for each
+	struct ParallelRange
+	{
+		Archetype* archetype;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	// entities matching a query split into the ranges run by parallel for each
+	struct ParallelPlan
+	{
+		std::vector<ParallelRange> ranges;
+
+		// entities the ranges without archetype index into
+		std::vector<Entity*> matched;
+
+		// change tick written and tick of the last run of the running system
+		uint32_t tick;
+		uint32_t since;
+	};
+
+	class ThreadPool;
+
+	// query class to iterate the entities with components Ts...
+	// get it with EntityManager::GetQuery<Ts...>() once and keep it
+	// iterating only visits the archetypes matching the query and never allocates
+	// if some of Ts... are sparse components, the smallest of their pools is iterated instead
+	// Ts... can be Changed<T> or Added<T> to only visit entities changed since the running system last ran
+	template <typename... Ts>
+	class Query
+	{
+	private:
+
+		EntityManager* entity_manager;
+		const QueryData* data;
+
+		static constexpr bool has_filter = HasQueryFilter<Ts...>::value;
+
+		// check the Changed and Added filters of Ts... for entity
+		bool PassesFilters(const Entity& entity, uint32_t since) const;
+
+		template <typename T>
+		bool PassesFilter(const Entity& entity, uint32_t since) const;
+
+		// mark the components of non-const Ts... changed
+		void MarkChanged(const Entity& entity, uint32_t tick) const;
+		void MarkChanged(Archetype* archetype, uint32_t tick) const;
+
+		// split the entities matching the query into ranges of at most grain entities
+		// entities of list are split instead of the archetypes if list is not null
+		ParallelPlan Plan(const std::vector<Entity*>* list, std::size_t grain) const;
+
+		// call fn(Entity&, Ts&...) for the entities of range, return the number of entities visited
+		template <typename F>
+		std::size_t RunRange(F& fn, const ParallelPlan& plan, const ParallelRange& range) const;
+
+		// call fn(range index, Entity&, Ts&...) for the entities of plan, one job per range
+		template <typename F>
+		void ParallelRun(F& fn, const ParallelPlan& plan) const;
+
+	public:
+
+		// iterator over the entities of a query
+		class Iterator
+		{
+		private:
+
+			const Query* query;
+
+			// pool iterated if the query has sparse components
+			const SparsePoolBase* pool;
+
+			// index of archetype or of pool
+			std::size_t index;
+			uint32_t row;
+
+			// skip empty archetypes or non-matching entities of pool
+			void Settle();
+
+		public:
+
+			Iterator(const Query* query, const SparsePoolBase* pool, std::size_t index)
+				: query(query), pool(pool), index(index), row(0)
+			{
+				Settle();
+			}
+
+			bool operator!=(const Iterator& itr) const
+			{
+				return index != itr.index || row != itr.row;
+			}
+
+			Iterator& operator++()
+			{
+				if (pool) ++index;
+				else ++row;
+				Settle();
+				return *this;
+			}
+
+			Entity& operator*() const;
+		};
+
+		Query(EntityManager& entity_manager, const QueryData& data) : entity_manager(&entity_manager), data(&data) {}
+
+		// number of entities matching the query
+		std::size_t Size() const
+		{
+			std::size_t n = 0;
+			if (data->sparse_types.empty() && !has_filter)
+			{
+				for (auto a : data->archetypes) n += a->Size();
+			}
+			else
+			{
+				for (auto itr = begin(); itr != end(); ++itr) ++n;
+			}
+			return n;
+		}
+
+		// archetypes with the components of the query stored in archetypes
+		const std::vector<Archetype*>& Archetypes() const
+		{
+			return data->archetypes;
+		}
+
+		// check whether some components of the query are sparse components
+		bool HasSparse() const
+		{
+			return !data->sparse_types.empty();
+		}
+
+		// call fn(Entity&, Ts&...) for every entity matching the query
+		// components of non-const Ts... are marked changed
+		// unsafe to add or remove entities or components inside fn
+		template <typename F>
+		void ForEach(F fn) const;
+
+		// call fn(Entity&, Ts&...) for every entity matching the query, split into jobs run by the thread pool of entity manager
+		// each job visits one archetype chunk, or at most grain entities if grain is not 0
+		// fn is called from several threads at once, unsafe to change anything but the components passed in inside fn
+		// components of non-const Ts... are marked changed
+		template <typename F>
+		void ParallelForEach(F fn, std::size_t grain = 0) const;
+
+		// same as above for the entities of list matching the query
+		// each job visits at most grain entities, PARALLEL_GRAIN if grain is 0
+		template <typename F>
+		void ParallelForEach(const std::vector<Entity*>& list, F fn, std::size_t grain = 0) const;
+
+		// accumulate fn(R&, Entity&, Ts&...) over every entity matching the query in parallel
+		// each job accumulates into its own copy of identity, and copies are combined in order with combine(R, R)
+		// jobs only depend on the entities and grain, so the result does not depend on the number of threads
+		template <typename R, typename F, typename C>
+		R ParallelReduce(R identity, F fn, C combine, std::size_t grain = 0) const;
+
+		// begin and end methods for iterating entities
+		Iterator begin() const;
+		Iterator end() const;
+	};
+
+	// prefab class to describe a set of components with default values
+	// spawn entities from it with EntityManager::Spawn
+	class Prefab
+	{
+	private:
+
+		friend class EntityManager;
+
+		// component with its default value
+		class PrototypeBase
+		{
+		public:
+
+			// type key of the component
+			uint32_t key;
+
+			explicit PrototypeBase(uint32_t key) : key(key) {}
+			virtual ~PrototypeBase() = default;
+
+			// get the component id of the component in the world of entity_manager
+			virtual uint32_t GetID(EntityManager& entity_manager) const = 0;
+
+			// copy construct n components at dst for entities first to first + n - 1
+			virtual void Construct(void* dst, std::size_t n, uint32_t first) const = 0;
+
+			// add a copy to the pool of sparse component for entities first to first + n - 1
+			virtual void Emplace(EntityManager& entity_manager, uint32_t first, std::size_t n) const = 0;
+		};
+
+		template <typename T>
+		class Prototype : public PrototypeBase
+		{
+		public:
+
+			T value;
+
+			template <typename... TArgs>
+			explicit Prototype(TArgs&&... args) : PrototypeBase(GetTypeKey<Component, T>()), value(std::forward<TArgs>(args)...) {}
+
+			uint32_t GetID(EntityManager& entity_manager) const override;
+
+			void Construct(void* dst, std::size_t n, uint32_t first) const override
+			{
+				T* c = static_cast<T*>(dst);
+				for (std::size_t i = 0; i < n; ++i)
+				{
+					new (c + i) T(value);
+					c[i].entity = first + static_cast<uint32_t>(i);
+				}
+			}
+
+			void Emplace(EntityManager& entity_manager, uint32_t first, std::size_t n) const override
+			{
+				EmplaceSparse(IsSparse<T>(), entity_manager, first, n);
+			}
+
+		private:
+
+			void EmplaceSparse(std::true_type, EntityManager& entity_manager, uint32_t first, std::size_t n) const;
+			void EmplaceSparse(std::false_type, EntityManager&, uint32_t, std::size_t) const {}
+		};
+
+		// components stored in archetypes and in sparse set pools
+		std::vector<std::unique_ptr<PrototypeBase>> table_components;
+		std::vector<std::unique_ptr<PrototypeBase>> sparse_components;
+
+		// type keys of the components added
+		ComponentSignature keys;
+
+	public:
+
+		// add component T with constructor arguments as default value
+		// replace the default value if T is already added
+		template <typename T, typename... TArgs>
+		Prefab& Add(TArgs&&... args)
+		{
+			uint32_t key = GetTypeKey<Component, T>();
+			auto& components = IsSparse<T>::value ? sparse_components : table_components;
+			components.erase(std::remove_if(components.begin(), components.end(),
+				[key](const std::unique_ptr<PrototypeBase>& p)
+				{
+					return p->key == key;
+				}),
+				components.end());
+
+			components.emplace_back(new Prototype<T>(std::forward<TArgs>(args)...));
+			keys.Set(key);
+			return *this;
+		}
+
+		// check whether component T is added
+		template <typename T>
+		bool Has() const
+		{
+			return keys.Test(GetTypeKey<Component, T>());
+		}
+
+		// get the default value of component T
+		// throw std::out_of_range if T is not added
+		template <typename T>
+		T& Get()
+		{
+			if (!Has<T>()) throw std::out_of_range("lecs: component is not added to the prefab");
+
+			uint32_t key = GetTypeKey<Component, T>();
+			auto& components = IsSparse<T>::value ? sparse_components : table_components;
+			auto itr = std::find_if(components.begin(), components.end(),
+				[key](const std::unique_ptr<PrototypeBase>& p)
+				{
+					return p->key == key;
+				});
+			return static_cast<Prototype<T>&>(**itr).value;
+		}
+	};
+
+	// contiguous range of entity ids
+	struct EntityRange
+	{
+		uint32_t first;
+		uint32_t count;
+
+		// check whether id is in the range
+		bool Contains(uint32_t id) const
+		{
+			return id - first < count;
+		}
+
+		uint32_t operator[](uint32_t i) const
+		{
+			return first + i;
+		}
+	};
+
+	// saved entity table of a world, shared between snapshots while no entity, component or group is added or removed
+	// the archetype and row of entities are saved with the archetypes
+	struct EntityTableState
+	{
+		// saved entity ids from TABLE_PAGE_SIZE * page
+		struct Page
+		{
+			// handle slot of each entity id, NULL_ID if there is no entity with the id
+			std::vector<uint32_t> handles;
+
+			// signature of each entity id
+			std::vector<uint64_t> signatures;
+		};
+
+		// number of entity ids
+		std::size_t size;
+		std::size_t signature_words;
+
+		// pages of the entity ids, shared while no entity id in the page changes
+		std::vector<std::shared_ptr<const Page>> pages;
+
+		uint32_t next_id;
+		std::vector<uint32_t> empty_id;
+		std::vector<uint32_t> destroying;
+
+		std::vector<HandleSlot> handle_slots;
+		std::vector<uint32_t> free_slots;
+
+		// ids of the entities of each group in order
+		std::array<std::vector<uint32_t>, GRP_SIZE> groups;
+	};
+
+	// saved entities and components of a world, taken by EntityManager::Snapshot
+	// parts unchanged since the previous snapshot or restore are shared instead of copied
+	struct WorldSnapshot
+	{
+		std::shared_ptr<const EntityTableState> table;
+
+		// state of each archetype in the order of EntityManager::archetypes
+		std::vector<std::shared_ptr<const ArchetypeState>> archetypes;
+
+		// state of the sparse set pool of each component id, null for components without pool
+		std::vector<std::shared_ptr<const SparsePoolState>> pools;
+	};
+
+	// writer of the binary format of worlds
+	class BinaryWriter
+	{
+	private:
+
+		std::ostream& out;
+		std::size_t offset = 0;
+
+	public:
+
+		explicit BinaryWriter(std::ostream& out) : out(out) {}
+
+		void Write(const void* data, std::size_t n)
+		{
+			out.write(static_cast<const char*>(data), n);
+			offset += n;
+		}
+
+		template <typename T>
+		void Write(const T& value)
+		{
+			Write(&value, sizeof(T));
+		}
+
+		// pad to a multiple of SERIAL_ALIGN bytes, so that blocks are aligned when the data is mapped in memory
+		void Align()
+		{
+			static const char zeros[SERIAL_ALIGN] = {};
+			Write(zeros, (SERIAL_ALIGN - offset % SERIAL_ALIGN) % SERIAL_ALIGN);
+		}
+	};
+
+	// reader of the binary format of worlds from memory
+	class BinaryReader
+	{
+	private:
+
+		const uint8_t* data;
+		std::size_t size;
+		std::size_t offset = 0;
+
+	public:
+
+		BinaryReader(const void* data, std::size_t size) : data(static_cast<const uint8_t*>(data)), size(size) {}
+
+		// get the next n bytes
+		// throw std::runtime_error if there are less than n bytes left
+		const uint8_t* Read(std::size_t n)
+		{
+			if (n > size - offset) throw std::runtime_error("lecs: unexpected end of world data");
+			const uint8_t* p = data + offset;
+			offset += n;
+			return p;
+		}
+
+		template <typename T>
+		T Read()
+		{
+			T value;
+			std::memcpy(&value, Read(sizeof(T)), sizeof(T));
+			return value;
+		}
+
+		// get the next n values of T
+		template <typename T>
+		std::vector<T> ReadArray(std::size_t n)
+		{
+			std::vector<T> values(n);
+			if (n) std::memcpy(values.data(), Read(sizeof(T) * n), sizeof(T) * n);
+			return values;
+		}
+
+		// skip the padding to a multiple of SERIAL_ALIGN bytes
+		void Align()
+		{
+			offset = std::min(size, (offset + SERIAL_ALIGN - 1) / SERIAL_ALIGN * SERIAL_ALIGN);
+		}
+	};
+
+	// entity container class for storing and filtering multiple entities
+	class EntityContainer
+	{
+	private:
+
+		EntityManager& entity_manager;
+
+	public:
+
+		// a vector of entity that contains the entities this container contains
+		std::vector<Entity*> entities;
+
+		explicit EntityContainer(EntityManager& entity_manager) : entity_manager(entity_manager) {}
+
+		// get an entity container that only contains entities with components T, Ts...
+		template <typename T, typename... Ts>
+		EntityContainer EntityFilter();
+
+		// call fn(Entity&, Ts&...) for every entity of this container with components Ts..., split into jobs of at most grain entities
+		// jobs are run by the thread pool of entity manager, PARALLEL_GRAIN entities each if grain is 0
+		// fn is called from several threads at once, unsafe to change anything but the components passed in inside fn
+		template <typename... Ts, typename F>
+		void ParallelForEach(F fn, std::size_t grain = 0);
+	};
+
+	class Hierarchy;
+
+	// entity manager class for managing all entities
+	class EntityManager
+	{
+	private:
+
+		friend class Entity;
+
+		uint32_t next_id = 0;
+
+		// logger of this world, shared with the other managers of the world by ECSManagers
+		std::shared_ptr<Logger> logger = std::make_shared<Logger>();
+
+		// component types used by this world
+		// declared first to be destroyed after archetypes
+		ComponentRegistry registry;
+
+		// thread pool running the jobs of parallel for each, null to run them on the calling thread
+		ThreadPool* thread_pool = nullptr;
+
+		// pools of entities and archetype chunks
+		// declared first to be destroyed after entities and archetypes
+		ObjectPool<Entity> entity_pool{ ENTITY_SLAB_SIZE };
+		SlabPool chunk_pool{ CHUNK_SIZE, CHUNK_SLAB_SIZE };
+
+		static const std::size_t n_group = GRP_SIZE;
+		std::array<EntityContainer*, n_group> groups;
+
+		// ids of entities destroyed to be removed in next update
+		std::vector<uint32_t> destroying;
+
+		// set entity inactive and destroy it in next update
+		void MarkDestroyed(Entity& entity)
+		{
+			if (!entity.active) return;
+			++structure_version;
+			entity.active = false;
+			destroying.push_back(entity.id);
+		}
+
+		void RemoveFromAllGroups(Entity& entity)
+		{
+			if (entity.group_bitset.none()) return;
+			for (auto i(0u); i < n_group; ++i)
+			{
+				RemoveFromGroup(&entity, i);
+			}
+		}
+
+		// archetype of each signature
+		std::unordered_map<ComponentSignature, Archetype*, ComponentSignature::Hash> archetype_map;
+
+		// archetype of entities without component
+		Archetype* root_archetype;
+
+		// registered queries of each signature
+		std::unordered_map<ComponentSignature, std::unique_ptr<QueryData>, ComponentSignature::Hash> queries;
+
+		// tick of the last system run, increased before each system runs
+		std::atomic<uint32_t> change_tick{ 0 };
+
+		// component signatures of all entities indexed by entity id
+		// each entity has signature_words 64 bit words, rows of destroyed entities are zero
+		std::vector<uint64_t> signatures;
+		std::size_t signature_words = 1;
+
+		// make the signature of each entity words 64 bit words long
+		void WidenSignatures(std::size_t words)
+		{
+			std::vector<uint64_t> widened(entities.size() * words, 0);
+			for (std::size_t e = 0; e < signatures.size() / signature_words; ++e)
+			{
+				std::copy_n(&signatures[e * signature_words], signature_words, &widened[e * words]);
+			}
+			signatures.swap(widened);
+			signature_words = words;
+		}
+
+		// add or remove component id from the signature of entity id
+		// all rows are widened if the component id does not fit
+		void SetComponentID(uint32_t id, uint32_t cid, bool value)
+		{
+			++structure_version;
+			MarkDirty(id);
+			if (cid / 64 >= signature_words) WidenSignatures(cid / 64 + 1);
+
+			uint64_t& word = signatures[id * signature_words + cid / 64];
+			if (value) word |= uint64_t(1) << (cid % 64);
+			else word &= ~(uint64_t(1) << (cid % 64));
+		}
+
+		// sparse set pool of each sparse component id, null for other components
+		std::vector<std::unique_ptr<SparsePoolBase>> pools;
+
+		// ids of sparse components with a pool
+		std::vector<uint32_t> sparse_types;
+
+		// command buffers to be applied in the next update
+		std::vector<CommandBuffer*> submitted;
+
+		// ids of the entities created by the command buffer being applied
+		std::vector<uint32_t> created;
+
+		// handle table mapping the handles of entities to their current ids
+		std::vector<HandleSlot> handle_slots;
+
+		// slots of destroyed entities to be reused
+		std::vector<uint32_t> free_slots;
+
+		// get a handle slot for entity id
+		uint32_t NewHandleSlot(uint32_t id)
+		{
+			if (free_slots.empty())
+			{
+				handle_slots.push_back(HandleSlot{ id, 0 });
+				return static_cast<uint32_t>(handle_slots.size() - 1);
+			}
+
+			uint32_t slot = free_slots.back();
+			free_slots.pop_back();
+			handle_slots[slot].id = id;
+			return slot;
+		}
+
+		// release the handle slot of a destroyed entity
+		void FreeHandleSlot(uint32_t slot)
+		{
+			handle_slots[slot].id = NULL_ID;
+			++handle_slots[slot].generation;
+			free_slots.push_back(slot);
+		}
+
+		// change the id of entity from to to, which must be free
+		// components stay in place, only the ids stored with them are changed
+		void RenameEntity(uint32_t from, uint32_t to)
+		{
+			++structure_version;
+			MarkDirty(from);
+			MarkDirty(to);
+			Entity& e = *entities[from];
+			e.id = to;
+			handle_slots[e.handle].id = to;
+			entities[to] = std::move(entities[from]);
+
+			std::copy_n(&signatures[from * signature_words], signature_words, &signatures[to * signature_words]);
+			std::fill_n(&signatures[from * signature_words], signature_words, 0);
+
+			// the components are changed without changing their ticks, so the archetype is marked changed for snapshots
+			Archetype* a = e.archetype;
+			++a->version;
+			for (std::size_t i = 0; i < a->types.size(); ++i)
+			{
+				a->infos[i]->set_entity(a->Get(a->types[i], e.row), to);
+			}
+			for (auto cid : sparse_types)
+			{
+				if (HasComponentID(to, cid)) pools[cid]->Rename(from, to);
+			}
+
+			if (!e.active) std::replace(destroying.begin(), destroying.end(), from, to);
+		}
+
+		// increased when an entity, component or group is added or removed
+		uint32_t structure_version = 0;
+
+		// entity table last saved or restored, with the structure version at that time
+		std::shared_ptr<const EntityTableState> synced_table;
+		uint32_t table_sync_version = 0;
+
+		// pages of the entity table with entity ids changed since the last save or restore
+		std::vector<uint8_t> dirty_pages;
+
+		// mark the page of entity id changed
+		void MarkDirty(uint32_t id)
+		{
+			std::size_t page = id / TABLE_PAGE_SIZE;
+			if (dirty_pages.size() <= page) dirty_pages.resize(page + 1, 0);
+			dirty_pages[page] = 1;
+		}
+
+		// check whether the page of the entity table changed since the last save or restore
+		bool IsDirty(std::size_t page) const
+		{
+			return page < dirty_pages.size() && dirty_pages[page];
+		}
+
+		// check whether page of synced table is the page of the entity table now
+		bool IsSyncedPage(std::size_t page, std::size_t size) const
+		{
+			return synced_table && synced_table->signature_words == signature_words && page < synced_table->pages.size() &&
+				synced_table->pages[page]->handles.size() == size && !IsDirty(page);
+		}
+
+		// save the entity table
+		// the table last saved or restored is returned if no entity, component or group is added or removed since
+		// unchanged pages are shared with it
+		std::shared_ptr<const EntityTableState> SaveTable()
+		{
+			if (synced_table && structure_version == table_sync_version) return synced_table;
+
+			std::shared_ptr<EntityTableState> table = std::make_shared<EntityTableState>();
+			table->size = entities.size();
+			table->signature_words = signature_words;
+			for (std::size_t begin = 0; begin < entities.size(); begin += TABLE_PAGE_SIZE)
+			{
+				std::size_t page = begin / TABLE_PAGE_SIZE;
+				std::size_t n = std::min(TABLE_PAGE_SIZE, entities.size() - begin);
+				if (IsSyncedPage(page, n))
+				{
+					table->pages.push_back(synced_table->pages[page]);
+					continue;
+				}
+
+				std::shared_ptr<EntityTableState::Page> p = std::make_shared<EntityTableState::Page>();
+				p->handles.resize(n);
+				for (std::size_t i = 0; i < n; ++i)
+				{
+					p->handles[i] = entities[begin + i] ? entities[begin + i]->handle : NULL_ID;
+				}
+				p->signatures.assign(signatures.begin() + begin * signature_words, signatures.begin() + (begin + n) * signature_words);
+				table->pages.push_back(p);
+			}
+
+			table->next_id = next_id;
+			table->empty_id = empty_id;
+			table->destroying = destroying;
+			table->handle_slots = handle_slots;
+			table->free_slots = free_slots;
+			for (auto group(0u); group < n_group; ++group)
+			{
+				for (auto e : groups[group]->entities) table->groups[group].push_back(e->id);
+			}
+
+			synced_table = table;
+			table_sync_version = structure_version;
+			std::fill(dirty_pages.begin(), dirty_pages.end(), 0);
+			return synced_table;
+		}
+
+		// restore the entity table
+		// entities are reused by id, entities with ids not in table are deleted
+		// the archetype and row of entities are restored with the archetypes
+		// pages which are the pages last saved or restored and unchanged since are not copied
+		void RestoreTable(const std::shared_ptr<const EntityTableState>& table)
+		{
+			if (table == synced_table && structure_version == table_sync_version) return;
+
+			for (auto group(0u); group < n_group; ++group)
+			{
+				for (auto e : groups[group]->entities) e->group_bitset[group] = false;
+				groups[group]->entities.clear();
+			}
+			for (auto id : destroying) entities[id]->active = true;
+
+			for (std::size_t id = table->size; id < entities.size(); ++id) entities[id].reset();
+			entities.resize(table->size);
+			signatures.resize(table->size * signature_words);
+
+			// signatures may have been widened since the table was saved
+			std::size_t words = table->signature_words;
+			for (std::size_t page = 0; page < table->pages.size(); ++page)
+			{
+				const auto& p = *table->pages[page];
+				if (IsSyncedPage(page, p.handles.size()) && synced_table->pages[page] == table->pages[page] && words == signature_words) continue;
+
+				uint32_t begin = static_cast<uint32_t>(page * TABLE_PAGE_SIZE);
+				for (uint32_t i = 0; i < p.handles.size(); ++i)
+				{
+					uint32_t id = begin + i;
+					if (p.handles[i] == NULL_ID) entities[id].reset();
+					else
+					{
+						if (!entities[id]) entities[id] = EntityPtr{ entity_pool.New(*this, id), EntityDeleter{ &entity_pool } };
+						entities[id]->handle = p.handles[i];
+					}
+
+					std::copy_n(&p.signatures[i * words], words, &signatures[id * signature_words]);
+					std::fill_n(&signatures[id * signature_words + words], signature_words - words, 0);
+				}
+			}
+
+			next_id = table->next_id;
+			empty_id = table->empty_id;
+			destroying = table->destroying;
+			handle_slots = table->handle_slots;
+			free_slots = table->free_slots;
+
+			for (auto id : destroying) entities[id]->active = false;
+			for (auto group(0u); group < n_group; ++group)
+			{
+				auto& g(groups[group]->entities);
+				for (auto id : table->groups[group])
+				{
+					Entity* e = entities[id].get();
+					e->group_bitset[group] = true;
+					e->group_index[group] = static_cast<uint32_t>(g.size());
+					g.push_back(e);
+				}
+			}
+
+			synced_table = table;
+			table_sync_version = ++structure_version;
+			std::fill(dirty_pages.begin(), dirty_pages.end(), 0);
+		}
+
+		// read the entities and components written by Save into this world, which must be empty
+		void Load(BinaryReader r)
+		{
+			if (r.Read<uint32_t>() != SERIAL_MAGIC) throw std::runtime_error("lecs: not world data");
+			if (r.Read<uint32_t>() != SERIAL_VERSION) throw std::runtime_error("lecs: unsupported world data version");
+
+			// component id in this world of each component type of the data
+			std::vector<uint32_t> cids(r.Read<uint32_t>());
+			for (auto& cid : cids)
+			{
+				uint32_t length = r.Read<uint32_t>();
+				std::string name(reinterpret_cast<const char*>(r.Read(length)), length);
+				uint32_t component_size = r.Read<uint32_t>();
+				bool sparse = r.Read<uint8_t>() != 0;
+
+				cid = FindComponentID(name.c_str());
+				if (cid == NULL_ID) continue;
+				const auto& info = GetComponentInfo(cid);
+				if (info.size != component_size || info.sparse != sparse || !info.trivial)
+				{
+					throw std::runtime_error("lecs: component type " + name + " does not match world data");
+				}
+			}
+			auto component_id = [&cids](uint32_t type)
+			{
+				if (type >= cids.size() || cids[type] == NULL_ID) throw std::runtime_error("lecs: component type of world data not used by this world");
+				return cids[type];
+			};
+
+			++structure_version;
+			uint32_t n_entity = r.Read<uint32_t>();
+			entities.resize(n_entity);
+			signatures.assign(n_entity * signature_words, 0);
+			next_id = n_entity;
+			uint32_t tick = WriteTick();
+
+			uint32_t n_archetype = r.Read<uint32_t>();
+			for (uint32_t i = 0; i < n_archetype; ++i)
+			{
+				std::vector<uint32_t> types = r.ReadArray<uint32_t>(r.Read<uint32_t>());
+				ComponentSignature signature;
+				for (auto& type : types)
+				{
+					type = component_id(type);
+					if (GetComponentInfo(type).sparse) throw std::runtime_error("lecs: sparse component stored in archetype in world data");
+					signature.Set(type);
+				}
+
+				uint32_t n = r.Read<uint32_t>();
+				r.Align();
+				std::vector<uint32_t> ids = r.ReadArray<uint32_t>(n);
+				std::vector<const uint8_t*> columns;
+				for (auto type : types)
+				{
+					r.Align();
+					columns.push_back(r.Read(GetComponentInfo(type).size * n));
+				}
+
+				if (signature.WordCount() > signature_words) WidenSignatures(signature.WordCount());
+				Archetype* a = GetArchetype(signature);
+				uint32_t first = a->AllocateRows(n);
+
+				for (uint32_t j = 0; j < n; ++j)
+				{
+					uint32_t id = ids[j], row = first + j;
+					if (id >= n_entity || entities[id]) throw std::runtime_error("lecs: invalid entity id in world data");
+
+					Entity* e(entity_pool.New(*this, id));
+					e->archetype = a;
+					e->row = row;
+					e->handle = NewHandleSlot(id);
+					a->Entities(row / a->capacity)[row % a->capacity] = e;
+					entities[id] = EntityPtr{ e, EntityDeleter{ &entity_pool } };
+					MarkDirty(id);
+
+					for (std::size_t w = 0; w < signature_words; ++w)
+					{
+						signatures[id * signature_words + w] = signature.Word(w);
+					}
+				}
+
+				// copy each column chunk by chunk
+				for (std::size_t c = 0; c < types.size(); ++c)
+				{
+					std::size_t component_size = GetComponentInfo(types[c]).size;
+					for (uint32_t row = first; row < first + n;)
+					{
+						uint32_t count = static_cast<uint32_t>(std::min<std::size_t>(a->capacity - row % a->capacity, first + n - row));
+						std::memcpy(a->Get(types[c], row), columns[c] + component_size * (row - first), component_size * count);
+						row += count;
+					}
+					std::fill_n(a->AddedTicks(types[c]) + first, n, tick);
+					std::fill_n(a->ChangedTicks(types[c]) + first, n, tick);
+				}
+			}
+
+			uint32_t n_pool = r.Read<uint32_t>();
+			for (uint32_t i = 0; i < n_pool; ++i)
+			{
+				uint32_t cid = component_id(r.Read<uint32_t>());
+				if (!GetComponentInfo(cid).sparse) throw std::runtime_error("lecs: component in sparse set pool is not sparse in world data");
+
+				uint32_t n = r.Read<uint32_t>();
+				r.Align();
+				std::vector<uint32_t> owners = r.ReadArray<uint32_t>(n);
+				r.Align();
+				const uint8_t* components = r.Read(GetComponentInfo(cid).size * n);
+
+				for (auto id : owners)
+				{
+					if (id >= n_entity || !entities[id] || HasComponentID(id, cid)) throw std::runtime_error("lecs: invalid entity id in world data");
+					SetComponentID(id, cid, true);
+				}
+				GetPool(cid).Load(owners.data(), components, n, tick);
+			}
+
+			for (auto id : r.ReadArray<uint32_t>(r.Read<uint32_t>()))
+			{
+				if (id >= n_entity || !entities[id]) throw std::runtime_error("lecs: invalid entity id in world data");
+				MarkDestroyed(*entities[id]);
+			}
+
+			uint32_t n_saved_group = r.Read<uint32_t>();
+			for (uint32_t group = 0; group < n_saved_group; ++group)
+			{
+				for (auto id : r.ReadArray<uint32_t>(r.Read<uint32_t>()))
+				{
+					if (group >= n_group || id >= n_entity || !entities[id]) throw std::runtime_error("lecs: invalid group in world data");
+					AddToGroup(entities[id].get(), group);
+				}
+			}
+
+			// the lowest free ids are reused first
+			for (uint32_t id = n_entity; id-- > 0;)
+			{
+				if (!entities[id]) empty_id.push_back(id);
+			}
+		}
+
+		// move the entities with old ids ids to the ids from 0, then shrink the entity table and the pools
+		// ids must contain every entity once
+		void CompactIds(const std::vector<uint32_t>& ids)
+		{
+			++structure_version;
+			std::size_t old_size = entities.size();
+			uint32_t n = static_cast<uint32_t>(ids.size());
+			dirty_pages.assign(old_size / TABLE_PAGE_SIZE + 1, 1);
+			std::vector<uint32_t> remap(old_size, NULL_ID);
+			for (uint32_t id = 0; id < n; ++id) remap[ids[id]] = id;
+
+			// entities are copied into a new pool in id order
+			// the old pool is swapped out and destroyed with its slabs
+			ObjectPool<Entity> compacted{ ENTITY_SLAB_SIZE };
+			std::vector<EntityPtr> dense(n);
+			std::vector<uint64_t> dense_signatures(n * signature_words);
+			for (uint32_t id = 0; id < n; ++id)
+			{
+				Entity* old = entities[ids[id]].release();
+				Entity* e = compacted.New(*old);
+				entity_pool.Delete(old);
+
+				e->id = id;
+				handle_slots[e->handle].id = id;
+				e->archetype->Entities(e->row / e->archetype->capacity)[e->row % e->archetype->capacity] = e;
+				for (auto group(0u); group < n_group; ++group)
+				{
+					if (e->group_bitset[group]) groups[group]->entities[e->group_index[group]] = e;
+				}
+				std::copy_n(&signatures[ids[id] * signature_words], signature_words, &dense_signatures[id * signature_words]);
+				dense[id] = EntityPtr{ e, EntityDeleter{ &entity_pool } };
+			}
+			entity_pool.Swap(compacted);
+			entities.swap(dense);
+			signatures.swap(dense_signatures);
+			empty_id.clear();
+
+			for (auto cid : sparse_types) pools[cid]->Remap(remap, n);
+
+			// chunks are allocated again from an empty pool in archetype order
+			SlabPool old_chunks{ CHUNK_SIZE, CHUNK_SLAB_SIZE };
+			chunk_pool.Swap(old_chunks);
+			for (auto& a : archetypes) a->SortRows(old_chunks);
+
+			// groups are sorted by id to be iterated in memory order
+			for (auto group(0u); group < n_group; ++group)
+			{
+				auto& g(groups[group]->entities);
+				std::sort(g.begin(), g.end(), [](const Entity* a, const Entity* b) { return a->id < b->id; });
+				for (uint32_t i = 0; i < g.size(); ++i) g[i]->group_index[group] = i;
+			}
+
+			ShrinkStorage();
+
+			LECS_LOG_INFO
+			(
+				LM_ENTITIES_COMPACTED, static_cast<uint32_t>(old_size), n, nullptr,
+				LT_ENTITY
+			);
+		}
+
+		// release the memory of the entity table and the pools not used after compaction
+		void ShrinkStorage()
+		{
+			next_id = static_cast<uint32_t>(entities.size());
+			entities.shrink_to_fit();
+			signatures.resize(entities.size() * signature_words);
+			signatures.shrink_to_fit();
+			empty_id.shrink_to_fit();
+			entity_pool.Trim();
+			chunk_pool.Trim();
+		}
+
+		// get the archetype with signature, create one if it does not exist
+		Archetype* GetArchetype(const ComponentSignature& signature)
+		{
+			auto it = archetype_map.find(signature);
+			if (it != archetype_map.end()) return it->second;
+
+			archetypes.emplace_back(new Archetype(signature, registry, chunk_pool));
+			Archetype* a = archetypes.back().get();
+			archetype_map.emplace(signature, a);
+
+			for (auto& q : queries)
+			{
+				if (signature.Contains(q.second->table_signature)) q.second->archetypes.push_back(a);
+			}
+			return a;
+		}
+
+		// get the archetype of entity after adding or removing component id
+		Archetype* GetNextArchetype(Entity& entity, uint32_t cid, bool add)
+		{
+			Archetype* src = entity.archetype;
+			auto& edges = add ? src->add_edges : src->remove_edges;
+			if (edges.size() <= cid) edges.resize(cid + 1, nullptr);
+			if (edges[cid] == nullptr)
+			{
+				auto signature = src->signature;
+				if (add) signature.Set(cid);
+				else signature.Reset(cid);
+				edges[cid] = GetArchetype(signature);
+			}
+			return edges[cid];
+		}
+
+		// move the components of entity to archetype dst
+		// components not in dst are destroyed, components only in dst are left unconstructed
+		void MoveEntity(Entity& entity, Archetype* dst)
+		{
+			Archetype* src = entity.archetype;
+			uint32_t src_row = entity.row;
+			uint32_t dst_row = dst->Allocate(&entity);
+
+			for (std::size_t i = 0; i < src->types.size(); ++i)
+			{
+				uint32_t cid = src->types[i];
+				const auto& info = *src->infos[i];
+				if (dst->signature.Test(cid))
+				{
+					info.move(dst->Get(cid, dst_row), src->Get(cid, src_row));
+					dst->AddedTicks(cid)[dst_row] = src->AddedTicks(cid)[src_row];
+					dst->ChangedTicks(cid)[dst_row] = src->ChangedTicks(cid)[src_row];
+				}
+				else info.destroy(src->Get(cid, src_row));
+			}
+			src->Release(src_row);
+
+			entity.archetype = dst;
+			entity.row = dst_row;
+		}
+
+		// destroy all components of entity
+		void DestroyComponents(Entity& entity)
+		{
+			++structure_version;
+			MarkDirty(entity.id);
+			entity.archetype->Remove(entity.row);
+			for (auto cid : sparse_types)
+			{
+				if (HasComponentID(entity.id, cid)) pools[cid]->Remove(entity.id);
+			}
+			std::fill_n(&signatures[entity.id * signature_words], signature_words, 0);
+		}
+
+		// add sparse component T to its pool
+		template <typename T, typename... TArgs>
+		T& EmplaceComponent(std::true_type, Entity& entity, TArgs&&... args)
+		{
+			return GetPool<T>().Emplace(entity.id, std::forward<TArgs>(args)...);
+		}
+
+		// add component T to the archetype of entity
+		// T is constructed before the row is moved or the old T destroyed, as args may refer to components of entity
+		template <typename T, typename... TArgs>
+		T& EmplaceComponent(std::false_type, Entity& entity, TArgs&&... args)
+		{
+			uint32_t cid = GetComponentTypeID<T>();
+			T component(std::forward<TArgs>(args)...);
+
+			T* c;
+			if (HasComponentID(entity.id, cid))
+			{
+				c = static_cast<T*>(entity.archetype->Get(cid, entity.row));
+				c->~T();
+			}
+			else
+			{
+				MoveEntity(entity, GetNextArchetype(entity, cid, true));
+				c = static_cast<T*>(entity.archetype->Get(cid, entity.row));
+			}
+
+			return *new (c) T(std::move(component));
+		}
+
+	public:
+
+		// archetypes storing the components of entities
+		// unsafe to add or remove rows directly
+		std::vector<std::unique_ptr<Archetype>> archetypes;
+
+		// unique_ptr of entities currently active
+		// unsafe to directly get entities through this vector as there will be nullptr
+		std::vector<EntityPtr> entities;
+
+		// vector of id of destroyed entities to be reused
+		std::vector<uint32_t> empty_id;
+
+		EntityManager()
+		{
+			for (auto i(0u); i < n_group; ++i)
+			{
+				groups[i] = new EntityContainer(*this);
+			}
+			root_archetype = GetArchetype(ComponentSignature());
+		}
+
+		~EntityManager()
+		{
+			for (auto g : groups) delete g;
+		}
+
+		EntityManager(const EntityManager&) = delete;
+		EntityManager& operator=(const EntityManager&) = delete;
+
+		// record command buffer to be applied in the next update
+		// buffer must stay alive until then, and it is emptied after applied
+		void Submit(CommandBuffer& buffer)
+		{
+			submitted.push_back(&buffer);
+		}
+
+		// apply the submitted command buffers in order
+		// destroyed entities are left inactive to be removed by the rest of the update
+		void ApplyCommands()
+		{
+			for (auto buffer : submitted)
+			{
+				created.clear();
+				buffer->ForEachCommand([this](CommandBuffer::Command& c, void* payload)
+				{
+					if (c.type == CMD_CREATE)
+					{
+						created.push_back(AddEntity().id);
+						return;
+					}
+
+					uint32_t id = c.entity & PENDING_ID ? created.at(c.entity & ~PENDING_ID) : c.entity;
+					Entity* e = id < entities.size() ? entities[id].get() : nullptr;
+					if (e == nullptr)
+					{
+						if (c.type == CMD_ADD_COMPONENT) c.info->destroy(payload);
+						LECS_LOG_ERROR
+						(
+							LM_ENTITY_NULL, id, NULL_ID, nullptr,
+							LT_ENTITY, LT_ERROR
+						);
+						return;
+					}
+
+					if (c.type == CMD_DESTROY) MarkDestroyed(*e);
+					else c.apply(*e, payload);
+				});
+				buffer->Reset();
+			}
+			submitted.clear();
+		}
+
+		// apply submitted command buffers, then destroy non active entities
+		void Update()
+		{
+			ApplyCommands();
+
+			for (auto id : destroying)
+			{
+				auto& e(entities[id]);
+				RemoveFromAllGroups(*e);
+				empty_id.push_back(id);
+				FreeHandleSlot(e->handle);
+				DestroyComponents(*e);
+				e.reset();
+
+				LECS_LOG_INFO
+				(
+					LM_ENTITY_DESTROYED, id, NULL_ID, nullptr,
+					LT_ENTITY, LT_DELETE
+				);
+			}
+			destroying.clear();
+		}
+
+		// immediately destroy the entity
+		void ImmediateDestroy(uint32_t id)
+		{
+			auto& e(entities.at(id));
+			if (!e->IsActive())
+			{
+				destroying.erase(std::find(destroying.begin(), destroying.end(), id));
+			}
+
+			RemoveFromAllGroups(*e);
+			empty_id.push_back(id);
+			FreeHandleSlot(e->handle);
+			DestroyComponents(*e);
+			e.reset();
+
+			LECS_LOG_INFO
+			(
+				LM_ENTITY_DESTROYED, id, NULL_ID, nullptr,
+				LT_ENTITY, LT_DELETE
+			);
+		}
+
+		// add entity
+		// return reference to the entity
+		Entity& AddEntity()
+		{
+			uint32_t new_id;
+			bool is_empty = empty_id.empty();
+			if (!is_empty)
+			{
+				new_id = empty_id.back();
+				empty_id.pop_back();
+			}
+			else
+			{
+				new_id = next_id++;
+			}
+
+			++structure_version;
+			MarkDirty(new_id);
+			Entity* e(entity_pool.New(*this, new_id));
+			e->archetype = root_archetype;
+			e->row = root_archetype->Allocate(e);
+			e->handle = NewHandleSlot(new_id);
+			EntityPtr u_ptr{ e, EntityDeleter{ &entity_pool } };
+			if (is_empty)
+			{
+				entities.resize(entities.size() + 1);
+				signatures.resize(entities.size() * signature_words, 0);
+			}
+			entities.at(e->id) = std::move(u_ptr);
+
+			LECS_LOG_INFO
+			(
+				LM_ENTITY_CREATED, e->id, NULL_ID, nullptr,
+				LT_ENTITY, LT_CREATE
+			);
+			return *e;
+		}
+
+		// spawn n entities with the components of prefab
+		// ids are not reused from destroyed entities so that they are contiguous
+		// rows of the archetype are allocated at once and components are copied from the prefab in bulk
+		EntityRange Spawn(const Prefab& prefab, uint32_t n)
+		{
+			EntityRange range{ next_id, n };
+			if (n == 0) return range;
+
+			// component ids of the prefab in this world
+			ComponentSignature signature;
+			ComponentSignature table_signature;
+			for (auto& p : prefab.table_components) table_signature.Set(p->GetID(*this));
+			signature = table_signature;
+			for (auto& p : prefab.sparse_components) signature.Set(p->GetID(*this));
+
+			++structure_version;
+			for (uint32_t id = range.first; id < range.first + n; id += TABLE_PAGE_SIZE) MarkDirty(id);
+			MarkDirty(range.first + n - 1);
+			next_id += n;
+			entities.resize(next_id);
+			if (signature.WordCount() > signature_words) WidenSignatures(signature.WordCount());
+			signatures.resize(entities.size() * signature_words, 0);
+
+			Archetype* a = GetArchetype(table_signature);
+			uint32_t first_row = a->AllocateRows(n);
+			uint32_t tick = WriteTick();
+
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				uint32_t id = range.first + i;
+				uint32_t row = first_row + i;
+				Entity* e(entity_pool.New(*this, id));
+				e->archetype = a;
+				e->row = row;
+				e->handle = NewHandleSlot(id);
+				a->Entities(row / a->capacity)[row % a->capacity] = e;
+				entities[id] = EntityPtr{ e, EntityDeleter{ &entity_pool } };
+
+				for (std::size_t w = 0; w < signature_words; ++w)
+				{
+					signatures[id * signature_words + w] = signature.Word(w);
+				}
+			}
+
+			// construct each component chunk by chunk
+			for (auto& p : prefab.table_components)
+			{
+				uint32_t cid = p->GetID(*this);
+				for (uint32_t row = first_row; row < first_row + n;)
+				{
+					uint32_t count = static_cast<uint32_t>(std::min<std::size_t>(a->capacity - row % a->capacity, first_row + n - row));
+					p->Construct(a->Get(cid, row), count, range.first + row - first_row);
+					row += count;
+				}
+
+				std::fill_n(a->AddedTicks(cid) + first_row, n, tick);
+				std::fill_n(a->ChangedTicks(cid) + first_row, n, tick);
+			}
+
+			for (auto& p : prefab.sparse_components)
+			{
+				uint32_t cid = p->GetID(*this);
+				p->Emplace(*this, range.first, n);
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					pools[cid]->AddedTick(range.first + i) = tick;
+					pools[cid]->ChangedTick(range.first + i) = tick;
+				}
+			}
+
+			LECS_LOG_INFO
+			(
+				LM_ENTITIES_SPAWNED, range.first, n, nullptr,
+				LT_ENTITY, LT_CREATE
+			);
+			return range;
+		}
+
+		// get entity by id
+		// return reference to the entity
+		Entity& GetEntity(uint32_t id)
+		{
+			if (entities.at(id) == nullptr)
+				LECS_LOG_ERROR
+				(
+					LM_ENTITY_NULL, id, NULL_ID, nullptr,
+					LT_ENTITY, LT_ERROR
+				);
+			return *entities.at(id).get();
+		}
+
+		// save the entities and components of this world
+		// parts unchanged since the last snapshot or restore are shared with it instead of copied
+		// trivially copyable components are copied with memcpy, other components must be copy constructible
+		// changes to components not seen by change detection are not seen by snapshots either, mark components changed when writing them
+		WorldSnapshot Snapshot()
+		{
+			uint32_t tick = WriteTick();
+
+			WorldSnapshot snapshot;
+			snapshot.table = SaveTable();
+			for (auto& a : archetypes) snapshot.archetypes.push_back(a->Save(tick));
+			snapshot.pools.resize(pools.size());
+			for (auto cid : sparse_types) snapshot.pools[cid] = pools[cid]->Save(tick);
+			return snapshot;
+		}
+
+		// restore the entities and components of this world to snapshot
+		// only the parts changed since the last snapshot or restore are copied
+		// entities existing both now and in snapshot are kept, references to components are invalidated
+		// component ticks are restored, the change tick keeps increasing
+		// submitted command buffers are dropped
+		void Restore(const WorldSnapshot& snapshot)
+		{
+			uint32_t tick = WriteTick();
+
+			RestoreTable(snapshot.table);
+			for (std::size_t i = 0; i < archetypes.size(); ++i)
+			{
+				if (i < snapshot.archetypes.size()) archetypes[i]->Restore(snapshot.archetypes[i], entities, tick);
+				else archetypes[i]->Clear();
+			}
+			for (auto cid : sparse_types)
+			{
+				if (cid < snapshot.pools.size() && snapshot.pools[cid]) pools[cid]->Restore(snapshot.pools[cid], tick);
+				else pools[cid]->Clear();
+			}
+			submitted.clear();
+		}
+
+		// destroy all entities and components at once, ids start from 0 again
+		// handles of the destroyed entities no longer resolve
+		void Clear()
+		{
+			++structure_version;
+			dirty_pages.assign(entities.size() / TABLE_PAGE_SIZE + 1, 1);
+
+			for (auto g : groups) g->entities.clear();
+			for (auto& a : archetypes) a->Clear();
+			for (auto cid : sparse_types) pools[cid]->Clear();
+			for (auto& e : entities)
+			{
+				if (e) FreeHandleSlot(e->handle);
+			}
+
+			entities.clear();
+			signatures.clear();
+			empty_id.clear();
+			destroying.clear();
+			submitted.clear();
+			next_id = 0;
+		}
+
+		// get the component id of the component type with name in this world
+		// return NULL_ID if this world never used the component type
+		uint32_t FindComponentID(const char* name) const
+		{
+			for (uint32_t cid = 0; cid < registry.Size(); ++cid)
+			{
+				if (std::strcmp(GetComponentInfo(cid).name, name) == 0) return cid;
+			}
+			return NULL_ID;
+		}
+
+		// write the entities and components of this world to out in a binary format
+		// each archetype is written as one block of entity ids and one block per component type, each sparse set pool as one block
+		// components must be trivially copyable, component types are written by name so the data is only valid for the same build
+		// entity ids and groups are kept, handles are not
+		void Save(std::ostream& out) const
+		{
+			BinaryWriter w(out);
+			w.Write(SERIAL_MAGIC);
+			w.Write(SERIAL_VERSION);
+
+			// component types in the order of component id
+			w.Write(registry.Size());
+			for (uint32_t cid = 0; cid < registry.Size(); ++cid)
+			{
+				const auto& info = GetComponentInfo(cid);
+				uint32_t length = static_cast<uint32_t>(std::strlen(info.name));
+				w.Write(length);
+				w.Write(info.name, length);
+				w.Write(static_cast<uint32_t>(info.size));
+				w.Write(static_cast<uint8_t>(info.sparse));
+			}
+
+			w.Write(static_cast<uint32_t>(entities.size()));
+
+			uint32_t n_archetype = 0;
+			for (auto& a : archetypes) n_archetype += a->Size() > 0;
+			w.Write(n_archetype);
+			for (auto& a : archetypes)
+			{
+				if (a->Size() == 0) continue;
+
+				w.Write(static_cast<uint32_t>(a->types.size()));
+				for (auto cid : a->types) w.Write(cid);
+				w.Write(static_cast<uint32_t>(a->Size()));
+
+				w.Align();
+				for (uint32_t row = 0; row < a->Size(); ++row) w.Write(a->GetEntity(row).id);
+
+				for (std::size_t i = 0; i < a->types.size(); ++i)
+				{
+					const auto& info = *a->infos[i];
+					if (!info.trivial) throw std::logic_error("lecs: component can not be serialized");
+
+					w.Align();
+					for (std::size_t chunk = 0; chunk < a->ChunkCount() && chunk * a->Capacity() < a->Size(); ++chunk)
+					{
+						w.Write(a->Column(a->types[i], chunk), info.size * a->ChunkSize(chunk));
+					}
+				}
+			}
+
+			uint32_t n_pool = 0;
+			for (auto cid : sparse_types) n_pool += pools[cid]->Size() > 0;
+			w.Write(n_pool);
+			for (auto cid : sparse_types)
+			{
+				const auto& pool = *pools[cid];
+				if (pool.Size() == 0) continue;
+
+				const auto& info = GetComponentInfo(cid);
+				if (!info.trivial) throw std::logic_error("lecs: component can not be serialized");
+
+				w.Write(cid);
+				w.Write(static_cast<uint32_t>(pool.Size()));
+				w.Align();
+				w.Write(pool.Entities(), sizeof(uint32_t) * pool.Size());
+				w.Align();
+				w.Write(pool.DenseData(), info.size * pool.Size());
+			}
+
+			w.Write(static_cast<uint32_t>(destroying.size()));
+			w.Write(destroying.data(), sizeof(uint32_t) * destroying.size());
+
+			w.Write(static_cast<uint32_t>(n_group));
+			for (auto g : groups)
+			{
+				w.Write(static_cast<uint32_t>(g->entities.size()));
+				for (auto e : g->entities) w.Write(e->id);
+			}
+		}
+
+		// replace the entities and components of this world with the ones written by Save to data of size bytes
+		// data can be a memory mapped file, components are copied into archetype chunks and sparse set pools in blocks
+		// component types are matched by name and must have been used by this world, for example with GetComponentTypeID<T>()
+		// throw std::runtime_error if data is not valid, this world is left empty
+		void Load(const void* data, std::size_t size)
+		{
+			Clear();
+			try
+			{
+				Load(BinaryReader(data, size));
+			}
+			catch (...)
+			{
+				Clear();
+				throw;
+			}
+		}
+
+		// replace the entities and components of this world with the ones written by Save to in
+		// in is read into memory at once
+		void Load(std::istream& in)
+		{
+			std::vector<char> data;
+			in.seekg(0, std::ios::end);
+			std::streamoff size = in.tellg();
+			if (size > 0)
+			{
+				in.seekg(0, std::ios::beg);
+				data.resize(static_cast<std::size_t>(size));
+				in.read(data.data(), size);
+				data.resize(static_cast<std::size_t>(in.gcount()));
+			}
+			else
+			{
+				in.clear();
+				data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			}
+			Load(data.data(), data.size());
+		}
+
+		// get the handle of entity
+		EntityHandle GetHandle(const Entity& entity) const
+		{
+			return EntityHandle{ entity.handle, handle_slots[entity.handle].generation };
+		}
+
+		// get the entity of handle
+		// return nullptr if the entity is destroyed
+		Entity* Resolve(EntityHandle handle) const
+		{
+			if (handle.slot >= handle_slots.size()) return nullptr;
+			const HandleSlot& slot = handle_slots[handle.slot];
+			if (slot.generation != handle.generation || slot.id == NULL_ID) return nullptr;
+			return entities[slot.id].get();
+		}
+
+		// move all active entities to the ids from 0 in order, then shrink the entity table and the pools
+		// entities are copied into new slabs and archetype rows are sorted by id, so entities close in id are close in memory
+		// submitted command buffers are applied and destroyed entities removed first
+		// references to entities and components are invalidated and ids change, use handles to keep entities across compaction
+		void Compact(CompactOrder order = CO_ID)
+		{
+			Update();
+
+			// old id of each entity in the new order
+			std::vector<uint32_t> ids;
+			ids.reserve(entities.size() - empty_id.size());
+			if (order == CO_SIGNATURE)
+			{
+				auto less_signature = [this](uint32_t a, uint32_t b)
+				{
+					const uint64_t* sa = &signatures[a * signature_words];
+					const uint64_t* sb = &signatures[b * signature_words];
+					return std::lexicographical_compare(sa, sa + signature_words, sb, sb + signature_words) ||
+						(std::equal(sa, sa + signature_words, sb) && a < b);
+				};
+
+				// archetype by archetype, entities with different sparse components are then ordered by signature
+				for (auto& a : archetypes)
+				{
+					std::size_t first = ids.size();
+					for (uint32_t row = 0; row < a->Size(); ++row) ids.push_back(a->GetEntity(row).id);
+					std::sort(ids.begin() + first, ids.end(), less_signature);
+				}
+			}
+			else
+			{
+				for (uint32_t id = 0; id < entities.size(); ++id)
+				{
+					if (entities[id]) ids.push_back(id);
+				}
+			}
+
+			if (order == CO_GROUP)
+			{
+				auto first_group = [this](uint32_t id)
+				{
+					const auto& bitset = entities[id]->group_bitset;
+					std::size_t group = 0;
+					while (group < n_group && !bitset[group]) ++group;
+					return group;
+				};
+				std::stable_sort(ids.begin(), ids.end(), [&first_group](uint32_t a, uint32_t b)
+				{
+					return first_group(a) < first_group(b);
+				});
+			}
+
+			CompactIds(ids);
+		}
+
+		// same as above, entities of hierarchy get the ids from 0 in depth-first order and the other entities the ids after them
+		// archetype rows follow the order of the nodes, so propagating transforms through hierarchy reads components in order
+		void Compact(Hierarchy& hierarchy);
+
+		// move at most max_moves entities from the end of the entity table to the lowest free ids, then shrink the table
+		// call once per frame to compact over several frames, entities stay in place and only their ids change
+		// references to entities and components stay valid, use handles to keep entities across compaction
+		// return true when no free id is left
+		bool CompactStep(std::size_t max_moves)
+		{
+			std::size_t old_size = entities.size();
+
+			// free ids in [lo, hi) are not filled yet
+			std::sort(empty_id.begin(), empty_id.end());
+			std::size_t lo = 0, hi = empty_id.size(), moves = 0;
+			while (true)
+			{
+				// drop free ids at the end of the table
+				while (hi > lo && empty_id[hi - 1] == entities.size() - 1)
+				{
+					entities.pop_back();
+					--hi;
+				}
+				if (lo == hi || moves == max_moves) break;
+
+				RenameEntity(static_cast<uint32_t>(entities.size() - 1), empty_id[lo++]);
+				entities.pop_back();
+				++moves;
+			}
+
+			// the lowest free ids are reused first
+			empty_id.erase(empty_id.begin() + hi, empty_id.end());
+			empty_id.erase(empty_id.begin(), empty_id.begin() + lo);
+			std::reverse(empty_id.begin(), empty_id.end());
+
+			next_id = static_cast<uint32_t>(entities.size());
+			signatures.resize(entities.size() * signature_words);
+			if (empty_id.empty()) ShrinkStorage();
+
+			if (entities.size() != old_size)
+				LECS_LOG_INFO
+				(
+					LM_ENTITIES_COMPACTED, static_cast<uint32_t>(old_size), static_cast<uint32_t>(entities.size()), nullptr,
+					LT_ENTITY
+				);
+			return empty_id.empty();
+		}
+
+		// add entity to group
+		void AddToGroup(Entity* entity, std::size_t group)
+		{
+			if (entity->group_bitset[group]) return;
+			++structure_version;
+
+			auto& g(groups[group]->entities);
+			entity->group_index[group] = static_cast<uint32_t>(g.size());
+			entity->group_bitset[group] = true;
+			g.push_back(entity);
+		}
+
+		// remove entity from group
+		// the last entity of the group is moved into its place
+		void RemoveFromGroup(Entity* entity, std::size_t group)
+		{
+			if (!entity->group_bitset[group]) return;
+			++structure_version;
+
+			auto& g(groups[group]->entities);
+			Entity* last = g.back();
+			g[entity->group_index[group]] = last;
+			last->group_index[group] = entity->group_index[group];
+			g.pop_back();
+			entity->group_bitset[group] = false;
+		}
+
+		// get the entity container representing the group
+		EntityContainer& GetGroup(std::size_t group)
+		{
+			return *groups[group];
+		}
+
+		// get an entity container that contains all the entities active
+		// safe to use compare to the vector of entities
+		EntityContainer EntityFilter()
+		{
+			EntityContainer en = EntityContainer(*this);
+			for (auto& e : entities)
+			{
+				if (!e) continue;
+				en.entities.emplace_back(entities.at(e->id).get());
+			}
+			return en;
+		}
+
+		// get the logger of this world
+		Logger& GetLogger() const
+		{
+			return *logger;
+		}
+
+		// replace the logger of this world
+		void SetLogger(std::shared_ptr<Logger> new_logger)
+		{
+			logger = std::move(new_logger);
+		}
+
+		// get the component id of component T in this world
+		// create a new component id if this world never used the component type before
+		template <typename T>
+		uint32_t GetComponentTypeID()
+		{
+			return registry.GetID<T>();
+		}
+
+		// get the informations of the component type with component id
+		const ComponentInfo& GetComponentInfo(uint32_t cid) const
+		{
+			return registry.GetInfo(cid);
+		}
+
+		// get the signature of components Ts... in this world
+		template <typename... Ts>
+		ComponentSignature Signature()
+		{
+			ComponentSignature signature;
+			int expand[] = { 0, (signature.Set(GetComponentTypeID<typename QueryTraits<Ts>::Component>()), 0)... };
+			(void)expand;
+			return signature;
+		}
+
+		// check whether entity id has component id
+		bool HasComponentID(uint32_t id, uint32_t cid) const
+		{
+			return cid / 64 < signature_words && (signatures[id * signature_words + cid / 64] >> (cid % 64)) & 1;
+		}
+
+		// check whether entity id has all components of all and none of none
+		// signatures with only the first 64 component ids only test the first word
+		bool Matches(uint32_t id, const ComponentSignature& all, const ComponentSignature& none = ComponentSignature()) const
+		{
+			const uint64_t* row = &signatures[id * signature_words];
+			if (all.IsSmall() && none.IsSmall()) return (row[0] & all.Word(0)) == all.Word(0) && !(row[0] & none.Word(0));
+
+			for (std::size_t i = 0; i < std::max(all.WordCount(), none.WordCount()); ++i)
+			{
+				uint64_t w = i < signature_words ? row[i] : 0;
+				if ((w & all.Word(i)) != all.Word(i) || (w & none.Word(i))) return false;
+			}
+			return true;
+		}
+
+		// append the ids of all entities with all components of all and none of none to out
+		// the dense array of signatures is scanned, with sse2 if available
+		// signatures with only the first 64 component ids only test the first word of each entity
+		void Match(const ComponentSignature& all, const ComponentSignature& none, std::vector<uint32_t>& out) const
+		{
+			const std::size_t n = entities.size();
+			const uint64_t* rows = signatures.data();
+
+			if (all.IsSmall() && none.IsSmall())
+			{
+				const uint64_t a = all.Word(0), x = none.Word(0);
+				for (std::size_t id = 0; id < n; ++id)
+				{
+					uint64_t w = rows[id * signature_words];
+					if ((w & a) == a && !(w & x) && entities[id]) out.push_back(static_cast<uint32_t>(id));
+				}
+				return;
+			}
+
+			// components beyond every entity signature can not be matched
+			if (all.WordCount() > signature_words) return;
+
+			std::vector<uint64_t> a(signature_words), x(signature_words);
+			for (std::size_t i = 0; i < signature_words; ++i)
+			{
+				a[i] = all.Word(i);
+				x[i] = none.Word(i);
+			}
+
+			for (std::size_t id = 0; id < n; ++id)
+			{
+				if (MatchSignatureWords(rows + id * signature_words, a.data(), x.data(), signature_words) && entities[id])
+				{
+					out.push_back(static_cast<uint32_t>(id));
+				}
+			}
+		}
+
+		// get the query of the entities with components Ts...
+		// the query is registered on first call and kept up to date afterwards
+		template <typename... Ts>
+		lecs::Query<Ts...> GetQuery()
+		{
+			auto signature = Signature<Ts...>();
+			auto it = queries.find(signature);
+			if (it == queries.end())
+			{
+				std::unique_ptr<QueryData> data(new QueryData());
+				data->signature = signature;
+				signature.ForEach([this, &data](uint32_t cid)
+				{
+					if (GetComponentInfo(cid).sparse) data->sparse_types.push_back(cid);
+					else data->table_signature.Set(cid);
+				});
+				for (auto& a : archetypes)
+				{
+					if (a->signature.Contains(data->table_signature)) data->archetypes.push_back(a.get());
+				}
+				it = queries.emplace(signature, std::move(data)).first;
+			}
+			return lecs::Query<Ts...>(*this, *it->second);
+		}
+
+		// get an entity container that only contains entities with components T, Ts...
+		// only the archetypes matching the components are visited
+		template <typename T, typename... Ts>
+		EntityContainer EntityFilter()
+		{
+			EntityContainer entities_with = EntityContainer(*this);
+			auto query = GetQuery<T, Ts...>();
+			if (!query.HasSparse() && !HasQueryFilter<T, Ts...>::value)
+			{
+				for (auto a : query.Archetypes())
+				{
+					for (std::size_t chunk = 0; chunk * a->capacity < a->size; ++chunk)
+					{
+						Entity** es = a->Entities(chunk);
+						entities_with.entities.insert(entities_with.entities.end(), es, es + a->ChunkSize(chunk));
+					}
+				}
+			}
+			else
+			{
+				for (auto& e : query) entities_with.entities.push_back(&e);
+			}
+			return entities_with;
+		}
+
+		// call fn(Entity&, Ts&...) for every entity with components Ts...
+		// components are read archetype by archetype from contiguous arrays
+		// unsafe to add or remove entities or components inside fn
+		template <typename... Ts, typename F>
+		void ForEach(F fn)
+		{
+			GetQuery<Ts...>().ForEach(fn);
+		}
+
+		// call fn(Entity&, Ts&...) for every entity with components Ts..., split into jobs run by the thread pool
+		// each job visits one archetype chunk, or at most grain entities if grain is not 0
+		// fn is called from several threads at once, unsafe to change anything but the components passed in inside fn
+		template <typename... Ts, typename F>
+		void ParallelForEach(F fn, std::size_t grain = 0)
+		{
+			GetQuery<Ts...>().ParallelForEach(fn, grain);
+		}
+
+		// accumulate fn(R&, Entity&, Ts&...) over every entity with components Ts... in parallel
+		// partial results are combined in order with combine(R, R), so the result does not depend on the number of threads
+		template <typename... Ts, typename R, typename F, typename C>
+		R ParallelReduce(R identity, F fn, C combine, std::size_t grain = 0)
+		{
+			return GetQuery<Ts...>().ParallelReduce(identity, fn, combine, grain);
+		}
+
+		// set the thread pool running the jobs of parallel for each
+		// set by SystemManager::SetWorkerCount, null to run jobs on the calling thread
+		void SetThreadPool(ThreadPool* pool)
+		{
+			thread_pool = pool;
+		}
+
+		ThreadPool* GetThreadPool() const
+		{
+			return thread_pool;
+		}
+
+		// get the sparse set pool of sparse component T
+		template <typename T>
+		SparsePool<T>& GetPool()
+		{
+			static_assert(IsSparse<T>::value, "component is not a sparse component");
+			return static_cast<SparsePool<T>&>(GetPool(GetComponentTypeID<T>()));
+		}
+
+		// get the sparse set pool of sparse component id
+		SparsePoolBase& GetPool(uint32_t cid)
+		{
+			if (pools.size() <= cid) pools.resize(cid + 1);
+			if (!pools[cid])
+			{
+				pools[cid].reset(GetComponentInfo(cid).new_pool());
+				sparse_types.push_back(cid);
+			}
+			return *pools[cid];
+		}
+
+		// get the smallest of the pools of sparse component ids
+		// return nullptr if one of them has no pool yet
+		const SparsePoolBase* SmallestPool(const std::vector<uint32_t>& cids) const
+		{
+			const SparsePoolBase* smallest = nullptr;
+			for (auto cid : cids)
+			{
+				if (cid >= pools.size() || !pools[cid]) return nullptr;
+				if (!smallest || pools[cid]->Size() < smallest->Size()) smallest = pools[cid].get();
+			}
+			return smallest;
+		}
+
+		// get the statistics of the entity pool, the chunk pool and the sparse set pools
+		std::vector<PoolStats> GetPoolStats() const
+		{
+			std::vector<PoolStats> stats;
+			stats.push_back(entity_pool.GetStats("Entity"));
+			stats.push_back(chunk_pool.GetStats("Chunk"));
+			for (auto cid : sparse_types) stats.push_back(pools[cid]->GetStats());
+			return stats;
+		}
+
+		// get component T of entity without checking whether entity has it
+		template <typename T>
+		T& Fetch(const Entity& entity)
+		{
+			uint32_t cid = GetComponentTypeID<T>();
+			if (IsSparse<T>::value) return static_cast<SparsePool<T>&>(*pools[cid]).Get(entity.id);
+			return *static_cast<T*>(entity.archetype->Get(cid, entity.row));
+		}
+
+		// add component T to entity, or replace it if entity already has T
+		// the entity is moved to the archetype with T, unless T is a sparse component
+		// the component is marked added if it is new and changed
+		template <typename T, typename... TArgs>
+		T& EmplaceComponent(Entity& entity, TArgs&&... args)
+		{
+			uint32_t cid = GetComponentTypeID<T>();
+			bool added = !HasComponentID(entity.id, cid);
+
+			T& c = EmplaceComponent<T>(IsSparse<T>(), entity, std::forward<TArgs>(args)...);
+			c.entity = entity.id;
+			SetComponentID(entity.id, cid, true);
+
+			uint32_t tick = WriteTick();
+			if (added) AddedTick(entity, cid) = tick;
+			ChangedTick(entity, cid) = tick;
+			return c;
+		}
+
+		// get the tick component id of entity was added and last changed
+		// entity must have the component
+		uint32_t& AddedTick(const Entity& entity, uint32_t cid)
+		{
+			if (GetComponentInfo(cid).sparse) return pools[cid]->AddedTick(entity.id);
+			return entity.archetype->AddedTicks(cid)[entity.row];
+		}
+		uint32_t& ChangedTick(const Entity& entity, uint32_t cid)
+		{
+			if (GetComponentInfo(cid).sparse) return pools[cid]->ChangedTick(entity.id);
+			return entity.archetype->ChangedTicks(cid)[entity.row];
+		}
+
+		// tick of changes made now
+		// the tick of the running system, or a tick after every system run so far outside of systems
+		uint32_t WriteTick() const
+		{
+			const SystemTicks& ticks = GetSystemTicks();
+			if (ticks.entity_manager == this) return ticks.tick;
+			return change_tick.load(std::memory_order_relaxed) + 1;
+		}
+
+		// increased when an entity, component or group is added or removed, or an entity is renamed
+		// unchanged if only the values of components changed
+		uint32_t StructureVersion() const
+		{
+			return structure_version;
+		}
+
+		// tick the running system last ran, changes after it are seen by Changed and Added filters
+		// 0 outside of systems, so that all changes are seen
+		uint32_t LastRunTick() const
+		{
+			const SystemTicks& ticks = GetSystemTicks();
+			return ticks.entity_manager == this ? ticks.last_run : 0;
+		}
+
+		// get a new tick for a system run
+		uint32_t AdvanceChangeTick()
+		{
+			return change_tick.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+
+		// mark component T of entity changed
+		template <typename T>
+		void MarkChanged(const Entity& entity)
+		{
+			ChangedTick(entity, GetComponentTypeID<T>()) = WriteTick();
+		}
+
+		// remove component T from entity
+		// the entity is moved to the archetype without T
+		template <typename T>
+		bool EraseComponent(Entity& entity)
+		{
+			uint32_t cid = GetComponentTypeID<T>();
+			if (!HasComponentID(entity.id, cid)) return false;
+
+			if (IsSparse<T>::value) pools[cid]->Remove(entity.id);
+			else MoveEntity(entity, GetNextArchetype(entity, cid, false));
+			SetComponentID(entity.id, cid, false);
+			return true;
+		}
+	};
+
+	// ring buffer of the snapshots of the last frames of a world, for rollback
+	// consecutive snapshots share the parts of the world unchanged between them
+	class SnapshotRing
+	{
+	private:
+
+		struct Slot
+		{
+			bool used = false;
+			uint32_t frame = 0;
+			WorldSnapshot snapshot;
+		};
+
+		// snapshot of frame is in slot frame % number of slots
+		std::vector<Slot> slots;
+
+	public:
+
+		explicit SnapshotRing(std::size_t n_frame = SNAPSHOT_FRAMES) : slots(n_frame) {}
+
+		// take a snapshot of entity manager for frame, replacing the snapshot n_frame frames before
+		void Save(EntityManager& entity_manager, uint32_t frame)
+		{
+			Slot& slot = slots[frame % slots.size()];
+			slot.used = true;
+			slot.frame = frame;
+			slot.snapshot = entity_manager.Snapshot();
+		}
+
+		// restore entity manager to frame and drop the snapshots of the frames after it
+		// return false if the snapshot of frame is not kept
+		bool Restore(EntityManager& entity_manager, uint32_t frame)
+		{
+			if (!Has(frame)) return false;
+			entity_manager.Restore(slots[frame % slots.size()].snapshot);
+
+			for (auto& slot : slots)
+			{
+				if (slot.used && slot.frame > frame) slot = Slot();
+			}
+			return true;
+		}
+
+		// check whether the snapshot of frame is kept
+		bool Has(uint32_t frame) const
+		{
+			const Slot& slot = slots[frame % slots.size()];
+			return slot.used && slot.frame == frame;
+		}
+
+		// get the snapshot of frame, nullptr if it is not kept
+		const WorldSnapshot* Get(uint32_t frame) const
+		{
+			return Has(frame) ? &slots[frame % slots.size()].snapshot : nullptr;
+		}
+
+		// drop all snapshots
+		void Clear()
+		{
+			for (auto& slot : slots) slot = Slot();
+		}
+	};
+
+	// position of the component of spatial grids as x and y
+	// component T has members x and y by default, for example a component deriving from lio::Vec2<float>
+	// specialize it for components storing the position elsewhere
+	template <typename T>
+	struct SpatialPosition
+	{
+		static float X(const T& component)
+		{
+			return static_cast<float>(component.x);
+		}
+		static float Y(const T& component)
+		{
+			return static_cast<float>(component.y);
+		}
+	};
+
+	// uniform grid of the entities with position component T for radius, AABB and nearest queries
+	// Update visits every entity with T, but re-bins only the entities whose T changed since the last update
+	// positions outside of the bounds are kept in the border cells, so the bounds only affect speed
+	// queries write entity ids into out, which is cleared and reused, so they do not allocate once out is large enough
+	template <typename T>
+	class SpatialGrid
+	{
+	private:
+
+		struct Item
+		{
+			uint32_t id;
+			float x;
+			float y;
+		};
+
+		// cell of an entity and its index in the cell
+		struct Entry
+		{
+			EntityHandle handle;
+			uint32_t cell = NULL_ID;
+			uint32_t index = 0;
+
+			// update the entity was last seen
+			uint32_t stamp = 0;
+		};
+
+		EntityManager& entity_manager;
+		Query<const T> query;
+
+		float min_x, min_y, cell_size;
+		uint32_t width, height;
+
+		std::vector<std::vector<Item>> cells;
+
+		// entries indexed by entity id
+		std::vector<Entry> entries;
+		std::size_t size = 0;
+
+		uint32_t stamp = 0;
+
+		// write tick of the last update, changes at or after it are moved in the next update
+		uint32_t since = 0;
+		bool built = false;
+
+		// structure version of entity manager at the last update
+		uint32_t structure = 0;
+
+		uint32_t CellX(float x) const
+		{
+			float c = (x - min_x) / cell_size;
+			if (!(c > 0)) return 0;
+			return c >= width ? width - 1 : static_cast<uint32_t>(c);
+		}
+		uint32_t CellY(float y) const
+		{
+			float c = (y - min_y) / cell_size;
+			if (!(c > 0)) return 0;
+			return c >= height ? height - 1 : static_cast<uint32_t>(c);
+		}
+
+		void Insert(uint32_t id, float x, float y)
+		{
+			Entry& entry = entries[id];
+			entry.cell = CellY(y) * width + CellX(x);
+			entry.index = static_cast<uint32_t>(cells[entry.cell].size());
+			cells[entry.cell].push_back(Item{ id, x, y });
+			++size;
+		}
+
+		void Remove(uint32_t id)
+		{
+			Entry& entry = entries[id];
+			auto& cell = cells[entry.cell];
+			cell[entry.index] = cell.back();
+			entries[cell[entry.index].id].index = entry.index;
+			cell.pop_back();
+			entry.cell = NULL_ID;
+			--size;
+		}
+
+		void Move(uint32_t id, float x, float y)
+		{
+			Entry& entry = entries[id];
+			if (entry.cell == CellY(y) * width + CellX(x))
+			{
+				Item& item = cells[entry.cell][entry.index];
+				item.x = x;
+				item.y = y;
+				return;
+			}
+			Remove(id);
+			Insert(id, x, y);
+		}
+
+		// squared distance from (x, y) to the indexed position of entity id
+		float Distance2(uint32_t id, float x, float y) const
+		{
+			const Entry& entry = entries[id];
+			const Item& item = cells[entry.cell][entry.index];
+			return (item.x - x) * (item.x - x) + (item.y - y) * (item.y - y);
+		}
+
+	public:
+
+		// grid of cells of cell_size covering the rectangle from (min_x, min_y) to (max_x, max_y)
+		SpatialGrid(EntityManager& entity_manager, float min_x, float min_y, float max_x, float max_y, float cell_size)
+			: entity_manager(entity_manager), query(entity_manager.GetQuery<const T>()),
+			min_x(min_x), min_y(min_y), cell_size(cell_size),
+			width(std::max(1u, static_cast<uint32_t>(std::ceil((max_x - min_x) / cell_size)))),
+			height(std::max(1u, static_cast<uint32_t>(std::ceil((max_y - min_y) / cell_size)))),
+			cells(static_cast<std::size_t>(width) * height)
+		{
+		}
+
+		// bring the grid up to date with the entities with T
+		// entities added, destroyed or renamed by compaction are found by their handles
+		// lecs keeps no list of the changed entities, so this is a pass over all entities with T and their change ticks
+		// handles are only compared and entities not seen only removed if entities or components were added or removed since the last update
+		// call it once per frame before the queries, for example at the start of the system using them
 		void Update()
 		{
-			for (auto i(0u); i < n_group; ++i)
+			uint32_t cid = entity_manager.GetComponentTypeID<T>();
+			uint32_t tick = entity_manager.WriteTick();
+
+			if (built && structure == entity_manager.StructureVersion())
+			{
+				if (query.HasSparse())
+				{
+					query.ForEach([&](Entity& e, const T& component)
+					{
+						if (!IsNewerTick(since, entity_manager.ChangedTick(e, cid)))
+							Move(e.id, SpatialPosition<T>::X(component), SpatialPosition<T>::Y(component));
+					});
+				}
+				else
+				{
+					// scan the change ticks of each archetype, only the changed rows are read
+					for (auto a : query.Archetypes())
+					{
+						const uint32_t* ticks = a->ChangedTicks(cid);
+						for (std::size_t chunk = 0; chunk < a->ChunkCount() && chunk * a->Capacity() < a->Size(); ++chunk)
+						{
+							const uint32_t* chunk_ticks = ticks + chunk * a->Capacity();
+							for (std::size_t i = 0, n = a->ChunkSize(chunk); i < n; ++i)
+							{
+								if (IsNewerTick(since, chunk_ticks[i])) continue;
+								const T& component = a->template Column<T>(chunk)[i];
+								Move(a->Entities(chunk)[i]->id, SpatialPosition<T>::X(component), SpatialPosition<T>::Y(component));
+							}
+						}
+					}
+				}
+				since = tick;
+				return;
+			}
+
+			if (++stamp == 0)
+			{
+				for (auto& entry : entries) entry.stamp = 0;
+				stamp = 1;
+			}
+
+			query.ForEach([&](Entity& e, const T& component)
+			{
+				if (entries.size() <= e.id) entries.resize(e.id + 1);
+				Entry& entry = entries[e.id];
+				EntityHandle handle = entity_manager.GetHandle(e);
+				float x = SpatialPosition<T>::X(component), y = SpatialPosition<T>::Y(component);
+
+				if (entry.cell == NULL_ID || entry.handle.slot != handle.slot || entry.handle.generation != handle.generation)
+				{
+					if (entry.cell != NULL_ID) Remove(e.id);
+					entry.handle = handle;
+					Insert(e.id, x, y);
+				}
+				else if (!built || !IsNewerTick(since, entity_manager.ChangedTick(e, cid)))
+				{
+					Move(e.id, x, y);
+				}
+				entries[e.id].stamp = stamp;
+			});
+
+			// remove the entities not seen, destroyed or without T
+			for (uint32_t id = 0; id < entries.size(); ++id)
+			{
+				if (entries[id].cell != NULL_ID && entries[id].stamp != stamp) Remove(id);
+			}
+
+			since = tick;
+			built = true;
+			structure = entity_manager.StructureVersion();
+		}
+
+		// move every entity to the cell of its current position
+		// call it instead of Update after restoring a snapshot or loading the world, as restored components keep their old change ticks
+		void Rebuild()
+		{
+			built = false;
+			Update();
+		}
+
+		// number of entities in the grid
+		std::size_t Size() const
+		{
+			return size;
+		}
+
+		// get the entities with position inside the rectangle from (x0, y0) to (x1, y1), borders included
+		void QueryAABB(float x0, float y0, float x1, float y1, std::vector<uint32_t>& out) const
+		{
+			out.clear();
+			for (uint32_t cy = CellY(y0); cy <= CellY(y1); ++cy)
+			{
+				for (uint32_t cx = CellX(x0); cx <= CellX(x1); ++cx)
+				{
+					for (const auto& item : cells[cy * width + cx])
+					{
+						if (item.x >= x0 && item.x <= x1 && item.y >= y0 && item.y <= y1) out.push_back(item.id);
+					}
+				}
+			}
+		}
+
+		// get the entities with position within radius of (x, y)
+		void QueryRadius(float x, float y, float radius, std::vector<uint32_t>& out) const
+		{
+			out.clear();
+			float radius2 = radius * radius;
+			for (uint32_t cy = CellY(y - radius); cy <= CellY(y + radius); ++cy)
+			{
+				for (uint32_t cx = CellX(x - radius); cx <= CellX(x + radius); ++cx)
+				{
+					for (const auto& item : cells[cy * width + cx])
+					{
+						if ((item.x - x) * (item.x - x) + (item.y - y) * (item.y - y) <= radius2) out.push_back(item.id);
+					}
+				}
+			}
+		}
+
+		// get the k entities nearest to (x, y), nearest first
+		// cells are searched in rings around (x, y) until no closer entity can be found
+		void QueryNearest(float x, float y, std::size_t k, std::vector<uint32_t>& out) const
+		{
+			out.clear();
+			if (k == 0 || size == 0) return;
+
+			// insert item into out, kept sorted by distance and at most k long
+			auto consider = [&](const Item& item)
+			{
+				float d = (item.x - x) * (item.x - x) + (item.y - y) * (item.y - y);
+				if (out.size() == k && d >= Distance2(out.back(), x, y)) return;
+				if (out.size() < k) out.push_back(item.id);
+
+				std::size_t i = out.size() - 1;
+				for (; i > 0 && Distance2(out[i - 1], x, y) > d; --i) out[i] = out[i - 1];
+				out[i] = item.id;
+			};
+			auto visit = [&](int64_t cx, int64_t cy)
+			{
+				if (cx < 0 || cy < 0 || cx >= width || cy >= height) return;
+				for (const auto& item : cells[cy * width + cx]) consider(item);
+			};
+
+			const int64_t cx = CellX(x), cy = CellY(y);
+			for (int64_t r = 0;; ++r)
+			{
+				const int64_t x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+				for (int64_t i = x0; i <= x1; ++i)
+				{
+					visit(i, y0);
+					if (r > 0) visit(i, y1);
+				}
+				for (int64_t j = y0 + 1; j < y1; ++j)
+				{
+					visit(x0, j);
+					visit(x1, j);
+				}
+
+				// distance to the nearest cell not visited yet, there are no cells beyond the sides at the border of the grid
+				float gap = std::numeric_limits<float>::infinity();
+				if (x0 > 0) gap = std::min(gap, x - (min_x + x0 * cell_size));
+				if (x1 < width - 1) gap = std::min(gap, min_x + (x1 + 1) * cell_size - x);
+				if (y0 > 0) gap = std::min(gap, y - (min_y + y0 * cell_size));
+				if (y1 < height - 1) gap = std::min(gap, min_y + (y1 + 1) * cell_size - y);
+
+				if (gap == std::numeric_limits<float>::infinity()) return;
+				if (out.size() == k && gap * gap >= Distance2(out.back(), x, y)) return;
+			}
+		}
+	};
+
+	// node of a hierarchy
+	struct HierarchyNode
+	{
+		EntityHandle handle;
+
+		// handle slot and index of the parent, NULL_ID for roots
+		uint32_t parent_slot;
+		uint32_t parent;
+
+		// number of nodes in the subtree, including this node
+		uint32_t size;
+
+		// the parent changed since the last propagation
+		bool moved;
+	};
+
+	// parent and child relationships between entities, kept in depth-first order so that every subtree is contiguous
+	// SetParent only records the new parent, Sort then moves the subtrees that changed, or sorts all nodes again if many changed
+	// entities are kept by handle, so compaction does not affect the hierarchy, and EntityManager::Compact(hierarchy) gives them ids in node order
+	// destroyed entities are removed on the next sort and their children become roots
+	class Hierarchy
+	{
+	private:
+
+		struct Link
+		{
+			EntityHandle self;
+			EntityHandle parent;
+		};
+
+		EntityManager& entity_manager;
+
+		// nodes in depth-first order, children after their parent
+		std::vector<HierarchyNode> nodes;
+
+		// index of the node and link of each handle slot
+		std::vector<uint32_t> index_of;
+		std::vector<Link> links;
+
+		// entities whose parent changed since the last sort
+		std::vector<EntityHandle> pending;
+
+		// entity of each node, resolved by the last sort
+		std::vector<Entity*> resolved;
+
+		// world component and whether to propagate of each node, reused by every propagation
+		std::vector<void*> worlds;
+		std::vector<uint8_t> dirty;
+
+		// write tick of the last propagation, changes at or after it are propagated in the next one
+		uint32_t since = 0;
+		bool propagated = false;
+
+		static bool Same(EntityHandle a, EntityHandle b)
+		{
+			return a.slot == b.slot && a.generation == b.generation;
+		}
+
+		Link& GetLink(EntityHandle handle)
+		{
+			if (links.size() <= handle.slot)
+			{
+				links.resize(handle.slot + 1);
+				index_of.resize(handle.slot + 1, NULL_ID);
+			}
+			Link& link = links[handle.slot];
+			if (!Same(link.self, handle)) link = Link{ handle, EntityHandle{} };
+			return link;
+		}
+
+		bool IsNode(EntityHandle handle) const
+		{
+			return handle.slot < index_of.size() && index_of[handle.slot] != NULL_ID && Same(nodes[index_of[handle.slot]].handle, handle);
+		}
+
+		// add handle as a root at the end
+		void AddRoot(EntityHandle handle)
+		{
+			GetLink(handle);
+			index_of[handle.slot] = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(HierarchyNode{ handle, NULL_ID, NULL_ID, 1, true });
+		}
+
+		// add handle and its parent as roots if they are not nodes yet
+		// destroyed entities and entities with a destroyed parent become roots
+		// return false if handle is destroyed and not a node
+		bool AddNodes(EntityHandle handle)
+		{
+			bool node = IsNode(handle);
+			bool alive = entity_manager.Resolve(handle) != nullptr;
+			if (!node && !alive) return false;
+
+			Link& link = GetLink(handle);
+			if (!alive || (link.parent.slot != NULL_ID && !entity_manager.Resolve(link.parent))) link.parent = EntityHandle{};
+			if (link.parent.slot != NULL_ID && !IsNode(link.parent)) AddRoot(link.parent);
+			if (!node) AddRoot(handle);
+			return true;
+		}
+
+		// a destroyed entity may still have a node in the slot of handle, remove it before the slot is reused
+		void ReleaseSlot(EntityHandle handle)
+		{
+			if (handle.slot < index_of.size() && index_of[handle.slot] != NULL_ID && !Same(nodes[index_of[handle.slot]].handle, handle)) Sort();
+		}
+
+		// move the subtree of handle to the end of the subtree of its new parent, or to the end if it becomes a root
+		// return false if the new parent is still in the subtree, as the parents set after it are not applied yet
+		bool MoveSubtree(EntityHandle handle)
+		{
+			if (!AddNodes(handle)) return true;
+			EntityHandle parent = links[handle.slot].parent;
+
+			uint32_t src = index_of[handle.slot];
+			uint32_t n = nodes[src].size;
+			if (nodes[src].parent_slot == parent.slot) return true;
+			if (parent.slot != NULL_ID && index_of[parent.slot] >= src && index_of[parent.slot] < src + n) return false;
+
+			uint32_t dst = static_cast<uint32_t>(nodes.size());
+			if (parent.slot != NULL_ID) dst = index_of[parent.slot] + nodes[index_of[parent.slot]].size;
+
+			for (uint32_t a = nodes[src].parent_slot; a != NULL_ID; a = nodes[index_of[a]].parent_slot) nodes[index_of[a]].size -= n;
+			for (uint32_t a = parent.slot; a != NULL_ID; a = nodes[index_of[a]].parent_slot) nodes[index_of[a]].size += n;
+			nodes[src].parent_slot = parent.slot;
+
+			uint32_t begin, end;
+			if (dst > src)
+			{
+				std::rotate(nodes.begin() + src, nodes.begin() + src + n, nodes.begin() + dst);
+				begin = src;
+				end = dst;
+			}
+			else
+			{
+				std::rotate(nodes.begin() + dst, nodes.begin() + src, nodes.begin() + src + n);
+				begin = dst;
+				end = src + n;
+			}
+			for (uint32_t i = begin; i < end; ++i) index_of[nodes[i].handle.slot] = i;
+			nodes[index_of[handle.slot]].moved = true;
+			return true;
+		}
+
+		// sort all nodes in depth-first order again from the parents of the links
+		// roots and children keep their order
+		void SortAll()
+		{
+			for (auto handle : pending) AddNodes(handle);
+
+			// children of each node as a linked list in node order
+			const uint32_t n = static_cast<uint32_t>(nodes.size());
+			std::vector<uint32_t> first(n, NULL_ID), last(n, NULL_ID), next(n, NULL_ID), roots;
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				EntityHandle parent = links[nodes[i].handle.slot].parent;
+				if (parent.slot == NULL_ID)
+				{
+					roots.push_back(i);
+					continue;
+				}
+				uint32_t p = index_of[parent.slot];
+				if (first[p] == NULL_ID) first[p] = i;
+				else next[last[p]] = i;
+				last[p] = i;
+			}
+
+			std::vector<HierarchyNode> sorted;
+			sorted.reserve(n);
+			std::vector<uint32_t> stack;
+			for (auto root : roots)
+			{
+				stack.push_back(root);
+				while (!stack.empty())
+				{
+					uint32_t i = stack.back();
+					stack.pop_back();
+					sorted.push_back(nodes[i]);
+
+					// push children in reverse so that they are visited in order
+					std::size_t top = stack.size();
+					for (uint32_t c = first[i]; c != NULL_ID; c = next[c]) stack.push_back(c);
+					std::reverse(stack.begin() + top, stack.end());
+				}
+			}
+			nodes.swap(sorted);
+
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				uint32_t parent_slot = links[nodes[i].handle.slot].parent.slot;
+				index_of[nodes[i].handle.slot] = i;
+				nodes[i].moved = nodes[i].moved || nodes[i].parent_slot != parent_slot;
+				nodes[i].parent_slot = parent_slot;
+				nodes[i].size = 1;
+			}
+			for (uint32_t i = n; i-- > 0;)
+			{
+				if (nodes[i].parent_slot != NULL_ID) nodes[index_of[nodes[i].parent_slot]].size += nodes[i].size;
+			}
+		}
+
+		// resolve the entity of each node, return false if some are destroyed
+		bool ResolveNodes()
+		{
+			resolved.resize(nodes.size());
+			bool alive = true;
+			for (std::size_t i = 0; i < nodes.size(); ++i)
+			{
+				resolved[i] = entity_manager.Resolve(nodes[i].handle);
+				alive = alive && resolved[i];
+			}
+			return alive;
+		}
+
+		// make the nodes of destroyed entities and their children roots on this sort
+		void RemoveDestroyed()
+		{
+			for (std::size_t i = 0; i < nodes.size(); ++i)
+			{
+				if (!resolved[i] || (nodes[i].parent_slot != NULL_ID && !resolved[index_of[nodes[i].parent_slot]])) pending.push_back(nodes[i].handle);
+			}
+		}
+
+	public:
+
+		explicit Hierarchy(EntityManager& entity_manager) : entity_manager(entity_manager) {}
+
+		// make parent the parent of child, the subtree of child is moved on the next sort
+		// return false if parent is child or a descendant of child
+		bool SetParent(const Entity& child, const Entity& parent)
+		{
+			EntityHandle c = entity_manager.GetHandle(child), p = entity_manager.GetHandle(parent);
+			ReleaseSlot(c);
+			ReleaseSlot(p);
+			for (EntityHandle a = p; a.slot != NULL_ID && entity_manager.Resolve(a); a = GetLink(a).parent)
+			{
+				if (Same(a, c)) return false;
+			}
+
+			Link& link = GetLink(c);
+			if (Same(link.parent, p) && IsNode(c)) return true;
+			link.parent = p;
+			pending.push_back(c);
+			return true;
+		}
+
+		// make child a root, the subtree of child is moved on the next sort
+		void RemoveParent(const Entity& child)
+		{
+			EntityHandle c = entity_manager.GetHandle(child);
+			ReleaseSlot(c);
+			Link& link = GetLink(c);
+			if (link.parent.slot == NULL_ID) return;
+			link.parent = EntityHandle{};
+			pending.push_back(c);
+		}
+
+		// get the parent of entity, nullptr for roots and entities not in the hierarchy
+		Entity* GetParent(const Entity& entity) const
+		{
+			EntityHandle handle = entity_manager.GetHandle(entity);
+			if (handle.slot >= links.size() || !Same(links[handle.slot].self, handle)) return nullptr;
+			return entity_manager.Resolve(links[handle.slot].parent);
+		}
+
+		// apply the parents set since the last sort and remove destroyed entities
+		// the subtrees that changed are moved one by one, or all nodes are sorted again if more than HIERARCHY_MOVES changed
+		void Sort()
+		{
+			if (!ResolveNodes()) RemoveDestroyed();
+			if (pending.empty()) return;
+
+			// sort all nodes if a subtree can not be moved yet
+			bool sorted = pending.size() <= HIERARCHY_MOVES;
+			for (std::size_t i = 0; sorted && i < pending.size(); ++i) sorted = MoveSubtree(pending[i]);
+			if (!sorted) SortAll();
+			pending.clear();
+
+			// dead nodes are roots of their own now
+			bool any = false;
+			for (auto& node : nodes)
+			{
+				if (entity_manager.Resolve(node.handle)) continue;
+				any = true;
+				index_of[node.handle.slot] = NULL_ID;
+				links[node.handle.slot] = Link();
+			}
+			if (any)
+			{
+				nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [this](const HierarchyNode& node)
+				{
+					return index_of[node.handle.slot] == NULL_ID;
+				}), nodes.end());
+				for (uint32_t i = 0; i < nodes.size(); ++i) index_of[nodes[i].handle.slot] = i;
+			}
+
+			for (auto& node : nodes)
+			{
+				node.parent = node.parent_slot == NULL_ID ? NULL_ID : index_of[node.parent_slot];
+			}
+			ResolveNodes();
+		}
+
+		// get the nodes in depth-first order, the subtree of node i is nodes i to i + size - 1
+		// call Sort first to include the latest changes
+		const std::vector<HierarchyNode>& Nodes() const
+		{
+			return nodes;
+		}
+
+		// call fn(Entity&) for each child of entity in order
+		// call Sort first to include the latest changes
+		template <typename F>
+		void ForEachChild(const Entity& entity, F fn) const
+		{
+			EntityHandle handle = entity_manager.GetHandle(entity);
+			if (!IsNode(handle)) return;
+			uint32_t i = index_of[handle.slot];
+			for (uint32_t c = i + 1; c < i + nodes[i].size; c += nodes[c].size)
+			{
+				if (Entity* child = entity_manager.Resolve(nodes[c].handle)) fn(*child);
+			}
+		}
+
+		// compute component World of each entity from its component Local and the World of its parent in one sweep, parents before children
+		// fn(const World* parent, const Local& local, World& world) is called with parent nullptr for roots, and World is marked changed
+		// only entities with Local changed or moved since the last propagation and their descendants are visited, or all if all is true
+		// entities without Local or World are skipped and their children are treated as roots
+		template <typename Local, typename World, typename F>
+		void PropagateTransforms(F fn, bool all = false)
+		{
+			Sort();
+
+			uint32_t local_id = entity_manager.GetComponentTypeID<Local>();
+			uint32_t world_id = entity_manager.GetComponentTypeID<World>();
+			uint32_t tick = entity_manager.WriteTick();
+			all = all || !propagated;
+
+			worlds.assign(nodes.size(), nullptr);
+			dirty.assign(nodes.size(), 0);
+			for (std::size_t i = 0; i < nodes.size(); ++i)
+			{
+				HierarchyNode& node = nodes[i];
+				Entity& e = *resolved[i];
+
+				bool moved = node.moved;
+				node.moved = false;
+				if (!entity_manager.HasComponentID(e.id, local_id) || !entity_manager.HasComponentID(e.id, world_id)) continue;
+
+				World& world = entity_manager.Fetch<World>(e);
+				worlds[i] = &world;
+
+				const World* parent = node.parent == NULL_ID ? nullptr : static_cast<const World*>(worlds[node.parent]);
+				dirty[i] = all || moved || (node.parent != NULL_ID && dirty[node.parent]) ||
+					!IsNewerTick(since, entity_manager.ChangedTick(e, local_id));
+				if (!dirty[i]) continue;
+
+				fn(parent, entity_manager.Fetch<Local>(e), world);
+				entity_manager.ChangedTick(e, world_id) = tick;
+			}
+
+			since = tick;
+			propagated = true;
+		}
+	};
+
+	// entities of hierarchy get the ids from 0 in depth-first order
+	inline void EntityManager::Compact(Hierarchy& hierarchy)
+	{
+		Update();
+		hierarchy.Sort();
+
+		std::vector<uint32_t> ids;
+		ids.reserve(entities.size() - empty_id.size());
+		std::vector<uint8_t> placed(entities.size(), 0);
+		for (const auto& node : hierarchy.Nodes())
+		{
+			uint32_t id = Resolve(node.handle)->id;
+			ids.push_back(id);
+			placed[id] = 1;
+		}
+		for (uint32_t id = 0; id < entities.size(); ++id)
+		{
+			if (entities[id] && !placed[id]) ids.push_back(id);
+		}
+
+		CompactIds(ids);
+	}
+
+	// add a copy to the pool of sparse component for entities first to first + n - 1
+	template <typename T>
+	void Prefab::Prototype<T>::EmplaceSparse(std::true_type, EntityManager& entity_manager, uint32_t first, std::size_t n) const
+	{
+		SparsePool<T>& pool = entity_manager.GetPool<T>();
+		for (uint32_t id = first; id < first + n; ++id)
+		{
+			pool.Emplace(id, value).entity = id;
+		}
+	}
+
+	inline Logger& Entity::GetLogger() const
+	{
+		return entity_manager.GetLogger();
+	}
+
+	// get the component id of component T in the world of this prototype
+	template <typename T>
+	uint32_t Prefab::Prototype<T>::GetID(EntityManager& entity_manager) const
+	{
+		return entity_manager.GetComponentTypeID<T>();
+	}
+
+	// destroy the entity
+	// immediate = false, destroy until the next update of entity manager
+	inline void Entity::Destroy(bool immediate)
+	{
+		if (immediate) entity_manager.ImmediateDestroy(id);
+		else entity_manager.MarkDestroyed(*this);
+	}
+
+	inline EntityHandle Entity::GetHandle() const
+	{
+		return entity_manager.GetHandle(*this);
+	}
+
+	inline void Entity::AddGroup(std::size_t group)
+	{
+		entity_manager.AddToGroup(this, group);
+	}
+
+	inline void Entity::RemoveGroup(std::size_t group)
+	{
+		entity_manager.RemoveFromGroup(this, group);
+	}
+
+	// check whether this entity has component T
+	template <typename T>
+	bool Entity::HasComponent() const
+	{
+		return entity_manager.HasComponentID(id, entity_manager.GetComponentTypeID<T>());
+	}
+
+	// get component T from this entity
+	// the component is marked changed
+	template <typename T>
+	T& Entity::GetComponent() const
+	{
+		// logs the missing component
+		if (!HasComponent<T>()) return const_cast<T&>(ReadComponent<T>());
+
+		entity_manager.MarkChanged<T>(*this);
+		return entity_manager.Fetch<T>(*this);
+	}
+
+	// get component T from this entity for reading, without marking it changed
+	template <typename T>
+	const T& Entity::ReadComponent() const
+	{
+		if (!HasComponent<T>())
+		{
+			LECS_LOG_WARNING
+			(
+				LM_COMPONENT_MISSING, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+				LT_WARNING
+			);
+			return *static_cast<T*>(nullptr);
+		}
+		return entity_manager.Fetch<T>(*this);
+	}
+
+	// mark component T of this entity changed
+	template <typename T>
+	void Entity::MarkChanged() const
+	{
+		entity_manager.MarkChanged<T>(*this);
+	}
+
+	// add component T to this entity
+	// pass in unique_ptr type
+	template <typename T>
+	T& Entity::AddComponent(std::unique_ptr<T> u_ptr)
+	{
+		T& c = entity_manager.EmplaceComponent<T>(*this, std::move(*u_ptr));
+
+		LECS_LOG_INFO
+		(
+			LM_COMPONENT_ADDED, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+			LT_COMPONENT, LT_CREATE
+		);
+		return c;
+	}
+
+	// pass in component
+	template <typename T>
+	T& Entity::AddComponent(const T& c)
+	{
+		T& added = entity_manager.EmplaceComponent<T>(*this, c);
+
+		LECS_LOG_INFO
+		(
+			LM_COMPONENT_ADDED, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+			LT_COMPONENT, LT_CREATE
+		);
+		return added;
+	}
+
+	// pass in contructor argument of component
+	template <typename T, typename... TArgs>
+	T& Entity::AddComponent(TArgs&&... mArgs)
+	{
+		T& c = entity_manager.EmplaceComponent<T>(*this, std::forward<TArgs>(mArgs)...);
+
+		LECS_LOG_INFO
+		(
+			LM_COMPONENT_ADDED, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+			LT_COMPONENT, LT_CREATE
+		);
+		return c;
+	}
+
+	// remove component T from this entity
+	template <typename T>
+	void Entity::RemoveComponent()
+	{
+		if (!entity_manager.EraseComponent<T>(*this))
+		{
+			LECS_LOG_WARNING
+			(
+				LM_COMPONENT_NOT_REMOVED, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+				LT_WARNING
+			);
+			return;
+		}
+
+		LECS_LOG_INFO
+		(
+			LM_COMPONENT_REMOVED, id, entity_manager.GetComponentTypeID<T>(), typeid(T).name(),
+			LT_COMPONENT, LT_DELETE
+		);
+	}
+
+	// skip empty archetypes or non-matching entities of pool
+	template <typename... Ts>
+	void Query<Ts...>::Iterator::Settle()
+	{
+		uint32_t since = has_filter ? query->entity_manager->LastRunTick() : 0;
+
+		if (pool)
+		{
+			const auto& signature = query->data->signature;
+			const uint32_t* owners = pool->Entities();
+			while (index < pool->Size() && (!query->entity_manager->Matches(owners[index], signature) ||
+				(has_filter && !query->PassesFilters(*query->entity_manager->entities[owners[index]], since))))
+			{
+				++index;
+			}
+			return;
+		}
+
+		const auto& archetypes = query->data->archetypes;
+		while (index < archetypes.size())
+		{
+			if (row >= archetypes[index]->Size())
+			{
+				++index;
+				row = 0;
+			}
+			else if (has_filter && !query->PassesFilters(archetypes[index]->GetEntity(row), since))
+			{
+				++row;
+			}
+			else break;
+		}
+	}
+
+	template <typename... Ts>
+	Entity& Query<Ts...>::Iterator::operator*() const
+	{
+		LECS_PROFILE_ENTITIES(1);
+		if (pool) return *query->entity_manager->entities[pool->Entities()[index]];
+		return query->data->archetypes[index]->GetEntity(row);
+	}
+
+	// call fn(Entity&, Ts&...) for every entity matching the query
+	// unsafe to add or remove entities or components inside fn
+	template <typename... Ts>
+	template <typename F>
+	void Query<Ts...>::ForEach(F fn) const
+	{
+		uint32_t tick = entity_manager->WriteTick();
+
+		if (data->sparse_types.empty() && !has_filter)
+		{
+			for (auto a : data->archetypes)
+			{
+				if (a->Size() == 0) continue;
+				LECS_PROFILE_ENTITIES(a->Size());
+				MarkChanged(a, tick);
+				a->ForEach<typename QueryTraits<Ts>::Component...>(fn);
+			}
+			return;
+		}
+
+		uint32_t since = entity_manager->LastRunTick();
+
+		if (data->sparse_types.empty())
+		{
+			for (auto a : data->archetypes)
+			{
+				for (uint32_t row = 0; row < a->Size(); ++row)
+				{
+					Entity& e = a->GetEntity(row);
+					if (!PassesFilters(e, since)) continue;
+					LECS_PROFILE_ENTITIES(1);
+					MarkChanged(e, tick);
+					fn(e, entity_manager->Fetch<typename QueryTraits<Ts>::Component>(e)...);
+				}
+			}
+			return;
+		}
+
+		const SparsePoolBase* pool = entity_manager->SmallestPool(data->sparse_types);
+		if (pool == nullptr) return;
+
+		const uint32_t* owners = pool->Entities();
+		for (std::size_t i = 0; i < pool->Size(); ++i)
+		{
+			if (!entity_manager->Matches(owners[i], data->signature)) continue;
+			Entity& e = *entity_manager->entities[owners[i]];
+			if (has_filter && !PassesFilters(e, since)) continue;
+			LECS_PROFILE_ENTITIES(1);
+			MarkChanged(e, tick);
+			fn(e, entity_manager->Fetch<typename QueryTraits<Ts>::Component>(e)...);
+		}
+	}
+
+	template <typename... Ts>
+	constexpr bool Query<Ts...>::has_filter;
+
+	template <typename... Ts>
+	bool Query<Ts...>::PassesFilters(const Entity& entity, uint32_t since) const
+	{
+		bool pass = true;
+		int expand[] = { 0, (pass = pass && PassesFilter<Ts>(entity, since), 0)... };
+		(void)expand, (void)since, (void)entity;
+		return pass;
+	}
+
+	template <typename... Ts>
+	template <typename T>
+	bool Query<Ts...>::PassesFilter(const Entity& entity, uint32_t since) const
+	{
+		typedef QueryTraits<T> Traits;
+		uint32_t cid = entity_manager->GetComponentTypeID<typename Traits::Component>();
+		if (Traits::changed && !IsNewerTick(entity_manager->ChangedTick(entity, cid), since)) return false;
+		if (Traits::added && !IsNewerTick(entity_manager->AddedTick(entity, cid), since)) return false;
+		return true;
+	}
+
+	template <typename... Ts>
+	void Query<Ts...>::MarkChanged(const Entity& entity, uint32_t tick) const
+	{
+		int expand[] = { 0, (QueryTraits<Ts>::writes ?
+			(void)(entity_manager->ChangedTick(entity, entity_manager->GetComponentTypeID<typename QueryTraits<Ts>::Component>()) = tick) : (void)0, 0)... };
+		(void)expand, (void)tick, (void)entity;
+	}
+
+	template <typename... Ts>
+	void Query<Ts...>::MarkChanged(Archetype* archetype, uint32_t tick) const
+	{
+		int expand[] = { 0, (QueryTraits<Ts>::writes ?
+			(void)std::fill_n(archetype->ChangedTicks(entity_manager->GetComponentTypeID<typename QueryTraits<Ts>::Component>()), archetype->Size(), tick) : (void)0, 0)... };
+		(void)expand, (void)tick;
+	}
+
+	// begin and end methods for iterating entities
+	template <typename... Ts>
+	typename Query<Ts...>::Iterator Query<Ts...>::begin() const
+	{
+		if (data->sparse_types.empty()) return Iterator(this, nullptr, 0);
+
+		const SparsePoolBase* pool = entity_manager->SmallestPool(data->sparse_types);
+		if (pool == nullptr) return end();
+		return Iterator(this, pool, 0);
+	}
+	template <typename... Ts>
+	typename Query<Ts...>::Iterator Query<Ts...>::end() const
+	{
+		if (data->sparse_types.empty()) return Iterator(this, nullptr, data->archetypes.size());
+
+		const SparsePoolBase* pool = entity_manager->SmallestPool(data->sparse_types);
+		if (pool == nullptr) return Iterator(this, nullptr, data->archetypes.size());
+		return Iterator(this, pool, pool->Size());
+	}
+
+	// get an entity container that only contains entities with components T, Ts...
+	template <typename T, typename... Ts>
+	EntityContainer EntityContainer::EntityFilter()
+	{
+		auto signature = entity_manager.Signature<T, Ts...>();
+		EntityContainer entities_with = EntityContainer(entity_manager);
+		for (auto& e : entities)
+		{
+			if (!e) continue;
+			if (entity_manager.Matches(e->id, signature)) entities_with.entities.emplace_back(e);
+		}
+		return entities_with;
+	}
+
+	class Event;
+	class EventManager;
+
+	// base event subscriber class for all class that will subscribe to events
+	class EventSubscriber
+	{
+	public:
+
+		// vector of id of subscribed event
+		std::vector<uint32_t> subscribed;
+
+		// receive function to be called when an subscribed event is emitted
+		virtual void Receive(Event&) {}
+	};
+
+	// base event class for all event class
+	class Event
+	{
+	private:
+
+		EventManager* event_manager;
+
+	public:
+
+		// event id of this event
+		uint32_t id;
+
+		// vector of subscribers to this event
+		std::vector<EventSubscriber*> subscribers;
+
+		virtual ~Event() = default;
+
+		// set the event manager
+		void SetEventManager(EventManager* event_manager)
+		{
+			this->event_manager = event_manager;
+		}
+
+		// downcast this event to derived event class
+		template <typename T>
+		T& Downcast()
+		{
+			return static_cast<T&>(*this);
+		}
+
+		// check whether this is of derived event class T
+		template <typename T>
+		bool IsEvent() const;
+	};
+
+	// bounded lock free queue of events posted from multiple threads and dispatched from one thread
+	// events are moved into fixed size slots with a function to deliver and destroy them
+	class EventPostQueue
+	{
+	private:
+
+		static_assert((EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) == 0, "EVENT_QUEUE_SIZE must be a power of 2");
+
+		struct Slot
+		{
+			std::atomic<std::size_t> sequence;
+			void (*deliver)(EventManager*, void*);
+			typename std::aligned_storage<EVENT_SLOT_SIZE, alignof(std::max_align_t)>::type storage;
+		};
+
+		std::unique_ptr<Slot[]> slots;
+
+		// producers and consumer positions padded to be on separate cache lines
+		std::atomic<std::size_t> enqueue_pos;
+		char padding[64];
+		std::size_t dequeue_pos = 0;
+
+	public:
+
+		EventPostQueue() : slots(new Slot[EVENT_QUEUE_SIZE]), enqueue_pos(0)
+		{
+			for (std::size_t i = 0; i < EVENT_QUEUE_SIZE; ++i)
+			{
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		~EventPostQueue()
+		{
+			Clear();
+		}
+
+		// construct event T in a slot
+		// return false without blocking if the queue is full
+		// thread safe
+		template <typename T, typename... TArgs>
+		bool Push(void (*deliver)(EventManager*, void*), TArgs&&... aArgs)
+		{
+			static_assert(sizeof(T) <= EVENT_SLOT_SIZE, "event is too large to be posted");
+			static_assert(alignof(T) <= alignof(std::max_align_t), "event is over aligned");
+
+			Slot* slot;
+			std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				slot = &slots[pos & (EVENT_QUEUE_SIZE - 1)];
+				std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+				if (diff == 0)
+				{
+					if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+
+			new (&slot->storage) T(std::forward<TArgs>(aArgs)...);
+			slot->deliver = deliver;
+			slot->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// deliver posted events, at most EVENT_QUEUE_SIZE of them
+		// only one thread may dispatch at a time
+		void Dispatch(EventManager& event_manager)
+		{
+			for (std::size_t n = 0; n < EVENT_QUEUE_SIZE; ++n)
+			{
+				Slot& slot = slots[dequeue_pos & (EVENT_QUEUE_SIZE - 1)];
+				if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) return;
+
+				slot.deliver(&event_manager, &slot.storage);
+				slot.sequence.store(dequeue_pos + EVENT_QUEUE_SIZE, std::memory_order_release);
+				++dequeue_pos;
+			}
+		}
+
+		// destroy events without delivering them
+		void Clear()
+		{
+			while (true)
+			{
+				Slot& slot = slots[dequeue_pos & (EVENT_QUEUE_SIZE - 1)];
+				if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) return;
+
+				// deliver without event manager only destroys the event
+				slot.deliver(nullptr, &slot.storage);
+				slot.sequence.store(dequeue_pos + EVENT_QUEUE_SIZE, std::memory_order_release);
+				++dequeue_pos;
+			}
+		}
+	};
+
+	// typed event handler stored by event manager
+	// function is a stub casting object and event back to their types
+	struct EventHandler
+	{
+		void* object;
+		void (*function)(void* object, const void* event);
+	};
+
+	// event manager class to manage all event
+	class EventManager
+	{
+	private:
+
+		EntityManager* entity_manager;
+		uint32_t next_event_id = 0;
+
+		// event id of each event type key, NULL_ID if the event type is not assigned an id
+		std::vector<uint32_t> event_ids;
+
+		// logger of the world
+		std::shared_ptr<Logger> logger = std::make_shared<Logger>();
+
+		// typed handlers indexed by event id
+		std::vector<std::vector<EventHandler>> handlers;
+
+		template <typename T, typename C, void (C::*F)(const T&)>
+		static void InvokeMember(void* object, const void* event)
+		{
+			(static_cast<C*>(object)->*F)(*static_cast<const T*>(event));
+		}
+
+		template <typename T, void (*F)(const T&)>
+		static void InvokeFunction(void*, const void* event)
+		{
+			F(*static_cast<const T*>(event));
+		}
+
+		template <typename T, typename F>
+		static void InvokeFunctor(void* object, const void* event)
+		{
+			(*static_cast<F*>(object))(*static_cast<const T*>(event));
+		}
+
+		template <typename T>
+		std::vector<EventHandler>& GetHandlers()
+		{
+			uint32_t id = GetEventID<T>();
+			if (id >= handlers.size()) handlers.resize(id + 1);
+			return handlers[id];
+		}
+
+		// emit to subscribers derived from EventSubscriber
+		// subscribers share the event, changes they make are seen by later subscribers and handlers
+		template <typename T>
+		void EmitToSubscribers(std::true_type, T& event)
+		{
+			uint32_t id = GetEventID<T>();
+			if (id >= events.size() || !events[id] || events[id]->subscribers.empty()) return;
+
+			event.SetEventManager(this);
+			event.id = id;
+			const auto& subs = events[id]->subscribers;
+			for (std::size_t i = 0, n = subs.size(); i < n && i < subs.size(); ++i)
+			{
+				subs[i]->Receive(event);
+			}
+		}
+
+		// event not derived from Event has no subscriber
+		template <typename T>
+		void EmitToSubscribers(std::false_type, T&) {}
+
+		// deliver an event to subscribers, then to handlers
+		template <typename T>
+		void Deliver(T& event)
+		{
+			EmitToSubscribers(std::is_base_of<Event, T>(), event);
+			Publish(event);
+		}
+
+		template <typename T>
+		static void DeliverPosted(EventManager* event_manager, void* event)
+		{
+			T* ev = static_cast<T*>(event);
+			if (event_manager) event_manager->Deliver(*ev);
+			ev->~T();
+		}
+
+		// buffer of queued events of one type
+		class EventQueueBase
+		{
+		public:
+
+			// whether the type is in the list of queued types
+			bool listed = false;
+
+			virtual ~EventQueueBase() = default;
+			virtual void Dispatch(EventManager& event_manager) = 0;
+		};
+
+		template <typename T>
+		class EventQueue : public EventQueueBase
+		{
+		public:
+
+			std::vector<T> events;
+
+			// events being delivered, kept to reuse its memory
+			std::vector<T> delivering;
+
+			void Dispatch(EventManager& event_manager) override
+			{
+				// events queued while delivering are delivered in the next dispatch
+				std::swap(events, delivering);
+				listed = false;
+
+				for (auto& ev : delivering)
+				{
+					event_manager.Deliver(ev);
+				}
+				delivering.clear();
+			}
+		};
+
+		// buffers of queued events indexed by event id
+		std::vector<std::unique_ptr<EventQueueBase>> queues;
+
+		// ids of event types queued since last dispatch in order of first event queued
+		std::vector<uint32_t> queued;
+		std::vector<uint32_t> dispatching;
+
+		// events posted from other threads
+		EventPostQueue posted;
+
+		template <typename T>
+		EventQueue<T>& GetQueue()
+		{
+			uint32_t id = GetEventID<T>();
+			if (id >= queues.size()) queues.resize(id + 1);
+			if (!queues[id]) queues[id].reset(new EventQueue<T>());
+			return static_cast<EventQueue<T>&>(*queues[id]);
+		}
+
+	public:
+
+		// vector of events
+		std::vector<std::unique_ptr<Event>> events;
+
+		EventManager() : entity_manager(nullptr) {}
+		explicit EventManager(EntityManager* entity_manager) : entity_manager(entity_manager) {}
+
+		// get the logger of the world
+		Logger& GetLogger() const
+		{
+			return *logger;
+		}
+
+		// replace the logger of the world
+		void SetLogger(std::shared_ptr<Logger> new_logger)
+		{
+			logger = std::move(new_logger);
+		}
+
+		// get the event id
+		// create a new event id if the event type is never assigned an id by this event manager before
+		template <typename T>
+		uint32_t GetEventID()
+		{
+			uint32_t key = GetTypeKey<Event, T>();
+			if (key >= event_ids.size()) event_ids.resize(key + 1, NULL_ID);
+			if (event_ids[key] == NULL_ID) event_ids[key] = next_event_id++;
+			return event_ids[key];
+		}
+
+		// unsubscribe an event from a subscriber
+		template <typename T>
+		void Unsubscribe(EventSubscriber* subscriber)
+		{
+			AddEvent<T>();
+			uint32_t id = GetEventID<T>();
+			events.at(id)->subscribers.erase(std::remove_if(
+				events.at(id)->subscribers.begin(), events.at(id)->subscribers.end(),
+				[subscriber](EventSubscriber* s)
+				{
+					return s == subscriber;
+				}),
+				events.at(id)->subscribers.end());
+
+			std::vector<uint32_t>* subscribed = &subscriber->subscribed;
+			subscribed->erase(std::remove_if(subscribed->begin(), subscribed->end(),
+				[id](const uint32_t& eID)
+				{
+					return eID == id;
+				}),
+				subscribed->end());
+		}
+
+		// subscribe event T from subscriber
+		template <typename T>
+		void Subscribe(EventSubscriber* subscriber)
+		{
+			AddEvent<T>();
+			events.at(GetEventID<T>())->subscribers.emplace_back(subscriber);
+			subscriber->subscribed.emplace_back(GetEventID<T>());
+		}
+
+		// add member function F of object as handler of event T
+		template <typename T, typename C, void (C::*F)(const T&)>
+		void AddHandler(C* object)
+		{
+			GetHandlers<T>().push_back(EventHandler{ object, &InvokeMember<T, C, F> });
+		}
+
+		// add function F as handler of event T
+		template <typename T, void (*F)(const T&)>
+		void AddHandler()
+		{
+			GetHandlers<T>().push_back(EventHandler{ nullptr, &InvokeFunction<T, F> });
+		}
+
+		// add functor as handler of event T
+		// functor is not copied and must outlive the handler
+		template <typename T, typename F>
+		void AddHandler(F& functor)
+		{
+			GetHandlers<T>().push_back(EventHandler{ &functor, &InvokeFunctor<T, F> });
+		}
+
+		// remove all handlers of event T added with object or functor
+		template <typename T>
+		void RemoveHandler(const void* object)
+		{
+			auto& hs = GetHandlers<T>();
+			hs.erase(std::remove_if(hs.begin(), hs.end(),
+				[object](const EventHandler& h)
+				{
+					return h.object == object;
+				}),
+				hs.end());
+		}
+
+		// remove function F as handler of event T
+		template <typename T, void (*F)(const T&)>
+		void RemoveHandler()
+		{
+			auto& hs = GetHandlers<T>();
+			hs.erase(std::remove_if(hs.begin(), hs.end(),
+				[](const EventHandler& h)
+				{
+					return h.function == &InvokeFunction<T, F>;
+				}),
+				hs.end());
+		}
+
+		// pass event to all handlers of event T
+		// handlers added during publish are not called for this event
+		template <typename T>
+		void Publish(const T& event)
+		{
+			uint32_t id = GetEventID<T>();
+			if (id >= handlers.size()) return;
+
+			const auto& hs = handlers[id];
+			for (std::size_t i = 0, n = hs.size(); i < n && i < hs.size(); ++i)
+			{
+				hs[i].function(hs[i].object, &event);
+			}
+		}
+
+		// queue event T to be delivered at next dispatch
+		// pass in aArgs to constructor of event T
+		template <typename T, typename... TArgs>
+		void Enqueue(TArgs&&... aArgs)
+		{
+			EventQueue<T>& queue = GetQueue<T>();
+			queue.events.emplace_back(std::forward<TArgs>(aArgs)...);
+			if (!queue.listed)
+			{
+				queue.listed = true;
+				queued.push_back(GetEventID<T>());
+			}
+		}
+
+		// post event T from any thread to be delivered at next dispatch
+		// return false without blocking if too many events are waiting
+		// pass in aArgs to constructor of event T
+		template <typename T, typename... TArgs>
+		bool Post(TArgs&&... aArgs)
+		{
+			return posted.Push<T>(&DeliverPosted<T>, std::forward<TArgs>(aArgs)...);
+		}
+
+		// deliver posted events, then queued events batched by type
+		void Dispatch()
+		{
+			posted.Dispatch(*this);
+
+			std::swap(queued, dispatching);
+			for (auto id : dispatching)
 			{
-				auto& g(groups[i]);
-				g->entities.erase(std::remove_if(std::begin(g->entities), std::end(g->entities),
-					[i](Entity* e)
-					{
-						return !e->IsActive() || !e->HasGroup(i);
-					}),
-					std::end(g->entities));
+				queues[id]->Dispatch(*this);
 			}
+			dispatching.clear();
+		}
 
-			for (auto& e : entities)
-			{
-				if (!e) continue;
-				if (!e->IsActive())
-				{
-					auto tmp = e->id;
-					empty_id.push_back(e->id);
-					delete e.release();
+		// emit event T to all handlers and subscribers of that event
+		// pass in aArgs to constructor of event T, the event is constructed once for all of them
+		template <typename T, typename... TArgs>
+		void Emit(TArgs&&... aArgs)
+		{
+			T event(std::forward<TArgs>(aArgs)...);
+			Deliver(event);
 
-					logger.AddLog
-					(
-						"Entity destroyed: Entity " + std::to_string(tmp) + " destroyed",
-						LT_ENTITY, LT_DELETE
-					);
-				}
-			}
+			LECS_LOG_INFO
+			(
+				LM_EVENT_EMITTED, NULL_ID, GetEventID<T>(), typeid(T).name(),
+				LT_EVENT
+			);
 		}
 
-		// immediately destroy the entity
-		void ImmediateDestroy(uint32_t id)
+		// add event type T
+		template <typename T>
+		bool AddEvent()
 		{
-			empty_id.push_back(id);
-			delete entities.at(id).release();
+			// event types used only with handlers take ids without adding events
+			if (GetEventID<T>() < events.size() && events[GetEventID<T>()]) return false;
+			T* ev(new T());
+			ev->id = GetEventID<T>();
+			std::unique_ptr<T> u_ptr{ ev };
+			if (ev->id >= events.size()) events.resize(ev->id + 1);
+			events.at(ev->id) = std::move(u_ptr);
 
-			logger.AddLog
+			LECS_LOG_INFO
 			(
-				"Entity destroyed: Entity " + std::to_string(id) + " destroyed",
-				LT_ENTITY, LT_DELETE
+				LM_EVENT_CREATED, NULL_ID, GetEventID<T>(), typeid(T).name(),
+				LT_EVENT, LT_CREATE
 			);
+
+			return true;
 		}
+	};
 
-		// add entity
-		// return reference to the entity
-		Entity& AddEntity()
+	// check whether this is of derived event class T
+	template <typename T>
+	bool Event::IsEvent() const
+	{
+		return id == event_manager->GetEventID<T>();
+	}
+
+	// job to be run by thread pool
+	struct Job
+	{
+		void (*function)(void* context, std::size_t index);
+		void* context;
+		std::size_t index;
+	};
+
+	// thread pool class to run jobs on worker threads
+	// each worker has its own queue of jobs, and steals jobs from the other queues when its own is empty
+	class ThreadPool
+	{
+	private:
+
+		struct JobQueue
 		{
-			uint32_t new_id;
-			bool is_empty = empty_id.empty();
-			if (!is_empty)
-			{
-				new_id = empty_id.back();
-				empty_id.pop_back();
-			}
-			else
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::thread> workers;
+
+		// queue of each worker, followed by the queue of jobs submitted by other threads
+		std::vector<std::unique_ptr<JobQueue>> queues;
+
+		// number of jobs in all queues
+		std::atomic<std::size_t> n_job{ 0 };
+
+		std::mutex mutex;
+
+		// notified when a job is submitted or the pool is stopping
+		std::condition_variable job_cv;
+
+		// notified when a job is submitted or finished
+		std::condition_variable idle_cv;
+
+		bool stopping = false;
+
+		// pool the calling thread works for and the index of its queue
+		struct WorkerSlot
+		{
+			const ThreadPool* pool = nullptr;
+			std::size_t queue = 0;
+		};
+
+		static WorkerSlot& CurrentWorker()
+		{
+			static thread_local WorkerSlot slot;
+			return slot;
+		}
+
+		// queue of the calling thread, the shared queue if it is not a worker of this pool
+		std::size_t OwnQueue() const
+		{
+			const WorkerSlot& slot = CurrentWorker();
+			return slot.pool == this ? slot.queue : workers.size();
+		}
+
+		// take a job from the back of queue own, or steal one from the front of another queue
+		bool TakeJob(std::size_t own, Job& job)
+		{
+			if (n_job.load() == 0) return false;
+
+			for (std::size_t i = 0; i < queues.size(); ++i)
 			{
-				new_id = next_id++;
+				std::size_t q = (own + i) % queues.size();
+				JobQueue& queue = *queues[q];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.jobs.empty()) continue;
+
+				if (i == 0)
+				{
+					job = queue.jobs.back();
+					queue.jobs.pop_back();
+				}
+				else
+				{
+					job = queue.jobs.front();
+					queue.jobs.pop_front();
+				}
+				--n_job;
+				return true;
 			}
+			return false;
+		}
 
-			Entity* e(new Entity(*this, new_id));
-			std::unique_ptr<Entity> u_ptr{ e };
-			if (is_empty) entities.resize(entities.size() + 1);
-			entities.at(e->id) = std::move(u_ptr);
+		// run job and wake threads waiting for it to finish
+		void RunJob(const Job& job)
+		{
+			job.function(job.context, job.index);
 
-			logger.AddLog
-			(
-				"Entity created: Entity " + std::to_string(e->id) + " created",
-				LT_ENTITY, LT_CREATE
-			);
-			return *e;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+			}
+			idle_cv.notify_all();
 		}
 
-		// get entity by id
-		// return reference to the entity
-		Entity& GetEntity(uint32_t id)
+		void WorkerLoop(std::size_t index)
 		{
-			if (entities.at(id) == nullptr)
-				logger.AddLog
-				(
-					"Error: Entity " + std::to_string(id) + " is nullptr",
-					LT_ENTITY, LT_ERROR
-				);
-			return *entities.at(id).get();
+			CurrentWorker().pool = this;
+			CurrentWorker().queue = index;
+
+			while (true)
+			{
+				Job job;
+				if (TakeJob(index, job))
+				{
+					RunJob(job);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mutex);
+				job_cv.wait(lock, [this] { return stopping || n_job.load() != 0; });
+				if (stopping && n_job.load() == 0) return;
+			}
 		}
 
-		// add entity to group
-		void AddToGroup(Entity* entity, std::size_t group)
+	public:
+
+		explicit ThreadPool(std::size_t n_worker)
 		{
-			groups[group]->entities.emplace_back(entity);
-			entity->AddGroup(group);
+			for (std::size_t i = 0; i <= n_worker; ++i)
+			{
+				queues.emplace_back(new JobQueue());
+			}
+			for (std::size_t i = 0; i < n_worker; ++i)
+			{
+				workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+			}
 		}
 
-		// remove entity from group
-		void RemoveFromGroup(Entity* entity, std::size_t group)
+		~ThreadPool()
 		{
-			entity->RemoveGroup(group);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			job_cv.notify_all();
+
+			for (auto& w : workers) w.join();
 		}
 
-		// get the entity container representing the group
-		EntityContainer& GetGroup(std::size_t group)
+		// number of worker threads
+		std::size_t WorkerCount() const
 		{
-			return *groups[group];
+			return workers.size();
 		}
 
-		// get an entity container that contains all the entities active
-		// safe to use compare to the vector of entities
-		EntityContainer EntityFilter()
+		// add a job to be run by a worker
+		// jobs submitted by a worker go to its own queue
+		void Submit(const Job& job)
 		{
-			EntityContainer en = EntityContainer(*this);
-			for (auto& e : entities)
+			// counted before pushed so that the count is never below the number of jobs queued
 			{
-				if (!e) continue;
-				en.entities.emplace_back(entities.at(e->id).get());
+				std::lock_guard<std::mutex> lock(mutex);
+				++n_job;
 			}
-			return en;
+			JobQueue& queue = *queues[OwnQueue()];
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.jobs.push_back(job);
+			}
+			job_cv.notify_one();
+			idle_cv.notify_all();
 		}
 
-		// get an entity container that only contains entities with component T
-		template <typename T>
-		EntityContainer EntityFilter()
+		// run jobs on the calling thread until pending reaches zero
+		// jobs must decrease pending when they are done
+		void Wait(const std::atomic<std::size_t>& pending)
 		{
-			EntityContainer entities_with = EntityContainer(*this);
-			for (auto& e : entities)
+			std::size_t own = OwnQueue();
+			while (pending.load() != 0)
 			{
-				if (!e) continue;
-				uint32_t id = e->id;
-				if (e->HasComponent<T>()) entities_with.entities.emplace_back(entities.at(id).get());
+				Job job;
+				if (TakeJob(own, job))
+				{
+					RunJob(job);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mutex);
+				idle_cv.wait(lock, [this, &pending] { return pending.load() == 0 || n_job.load() != 0; });
 			}
-			return entities_with;
 		}
 	};
 
-	// destroy the entity
-	// immediate = false, destroy until the next update of entity manager
-	inline void Entity::Destroy(bool immediate)
+	// call body(i) for i from 0 to n - 1, each as a job run by pool
+	// runs on the calling thread if pool is null or has no worker
+	// jobs see the change ticks of the calling thread, so changes made in them are marked with the tick of the running system
+	template <typename F>
+	void ParallelFor(ThreadPool* pool, std::size_t n, F& body)
 	{
-		active = false;
-		if (immediate) entity_manager.ImmediateDestroy(id);
+		if (pool == nullptr || pool->WorkerCount() == 0 || n <= 1)
+		{
+			for (std::size_t i = 0; i < n; ++i) body(i);
+			return;
+		}
+
+		struct Context
+		{
+			F* body;
+			SystemTicks ticks;
+			std::atomic<std::size_t> pending;
+		};
+		Context context;
+		context.body = &body;
+		context.ticks = GetSystemTicks();
+		context.pending.store(n);
+
+		auto run = [](void* ptr, std::size_t index)
+		{
+			Context& c = *static_cast<Context*>(ptr);
+			SystemTicks& ticks = GetSystemTicks();
+			SystemTicks outer = ticks;
+			ticks = c.ticks;
+			(*c.body)(index);
+			ticks = outer;
+			--c.pending;
+		};
+
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			pool->Submit(Job{ run, &context, i });
+		}
+		pool->Wait(context.pending);
 	}
 
-	// get an entity container that only contains entities with component T
-	template <typename T>
-	EntityContainer EntityContainer::EntityFilter()
+	// split the entities matching the query into ranges of at most grain entities
+	// entities of list are split instead of the archetypes if list is not null
+	template <typename... Ts>
+	ParallelPlan Query<Ts...>::Plan(const std::vector<Entity*>* list, std::size_t grain) const
 	{
+		ParallelPlan plan;
+		plan.tick = entity_manager->WriteTick();
+		plan.since = entity_manager->LastRunTick();
+
+		if (list == nullptr && data->sparse_types.empty())
 		{
-			EntityContainer entities_with = EntityContainer(entity_manager);
-			for (auto& e : entities)
+			for (auto a : data->archetypes)
 			{
-				if (!e) continue;
-				uint32_t id = e->id;
-				if (e->HasComponent<T>()) entities_with.entities.emplace_back(entity_manager.entities.at(id).get());
+				if (a->Size() == 0) continue;
+				if (!has_filter) MarkChanged(a, plan.tick);
+
+				std::size_t step = grain == 0 ? a->Capacity() : std::min(grain, a->Capacity());
+				for (std::size_t chunk = 0; chunk < a->ChunkCount() && chunk * a->Capacity() < a->Size(); ++chunk)
+				{
+					std::size_t end = chunk * a->Capacity() + a->ChunkSize(chunk);
+					for (std::size_t begin = chunk * a->Capacity(); begin < end; begin += step)
+					{
+						plan.ranges.push_back(ParallelRange{ a, static_cast<uint32_t>(begin), static_cast<uint32_t>(std::min(begin + step, end)) });
+					}
+				}
 			}
-			return entities_with;
+			return plan;
+		}
+
+		if (list == nullptr)
+		{
+			for (auto& e : *this) plan.matched.push_back(&e);
+		}
+		else
+		{
+			for (auto e : *list)
+			{
+				if (e == nullptr || !entity_manager->Matches(e->id, data->signature)) continue;
+				if (has_filter && !PassesFilters(*e, plan.since)) continue;
+				plan.matched.push_back(e);
+			}
+		}
+
+		std::size_t step = grain == 0 ? PARALLEL_GRAIN : grain;
+		for (std::size_t begin = 0; begin < plan.matched.size(); begin += step)
+		{
+			plan.ranges.push_back(ParallelRange{ nullptr, static_cast<uint32_t>(begin), static_cast<uint32_t>(std::min(begin + step, plan.matched.size())) });
 		}
+		return plan;
 	}
 
-	class Event;
-	class EventManager;
+	// call fn(Entity&, Ts&...) for the entities of range, return the number of entities visited
+	template <typename... Ts>
+	template <typename F>
+	std::size_t Query<Ts...>::RunRange(F& fn, const ParallelPlan& plan, const ParallelRange& range) const
+	{
+		Archetype* a = range.archetype;
+		if (a != nullptr && !has_filter)
+		{
+			a->ForEach<typename QueryTraits<Ts>::Component...>(fn, range.begin, range.end);
+			return range.end - range.begin;
+		}
 
-	// base event subscriber class for all class that will subscribe to events
-	class EventSubscriber
+		std::size_t visited = 0;
+		for (uint32_t i = range.begin; i < range.end; ++i)
+		{
+			Entity& e = a != nullptr ? a->GetEntity(i) : *plan.matched[i];
+			if (a != nullptr && !PassesFilters(e, plan.since)) continue;
+			MarkChanged(e, plan.tick);
+			fn(e, entity_manager->Fetch<typename QueryTraits<Ts>::Component>(e)...);
+			++visited;
+		}
+		return visited;
+	}
+
+	// call fn(range index, Entity&, Ts&...) for the entities of plan, one job per range
+	template <typename... Ts>
+	template <typename F>
+	void Query<Ts...>::ParallelRun(F& fn, const ParallelPlan& plan) const
 	{
-	public:
+		std::atomic<std::size_t> visited{ 0 };
+		auto body = [this, &fn, &plan, &visited](std::size_t i)
+		{
+			auto range_fn = [&fn, i](Entity& e, typename QueryTraits<Ts>::Component&... components)
+			{
+				fn(i, e, components...);
+			};
+			visited += RunRange(range_fn, plan, plan.ranges[i]);
+		};
+		ParallelFor(entity_manager->GetThreadPool(), plan.ranges.size(), body);
+		LECS_PROFILE_ENTITIES(visited.load());
+	}
 
-		// vector of id of subscribed event
-		std::vector<uint32_t> subscribed;
+	template <typename... Ts>
+	template <typename F>
+	void Query<Ts...>::ParallelForEach(F fn, std::size_t grain) const
+	{
+		auto range_fn = [&fn](std::size_t, Entity& e, typename QueryTraits<Ts>::Component&... components)
+		{
+			fn(e, components...);
+		};
+		ParallelRun(range_fn, Plan(nullptr, grain));
+	}
 
-		// receive function to be called when an subscribed event is emitted
-		virtual void Receive(Event&) {}
+	template <typename... Ts>
+	template <typename F>
+	void Query<Ts...>::ParallelForEach(const std::vector<Entity*>& list, F fn, std::size_t grain) const
+	{
+		auto range_fn = [&fn](std::size_t, Entity& e, typename QueryTraits<Ts>::Component&... components)
+		{
+			fn(e, components...);
+		};
+		ParallelRun(range_fn, Plan(&list, grain));
+	}
+
+	// accumulate fn(R&, Entity&, Ts&...) over every entity matching the query in parallel
+	// each range has its own partial result, combined in the order of the ranges
+	template <typename... Ts>
+	template <typename R, typename F, typename C>
+	R Query<Ts...>::ParallelReduce(R identity, F fn, C combine, std::size_t grain) const
+	{
+		ParallelPlan plan = Plan(nullptr, grain);
+
+		// wrapped so that a vector of bool stores separate objects
+		struct Partial
+		{
+			R value;
+		};
+		std::vector<Partial> partials(plan.ranges.size(), Partial{ identity });
+
+		// each job accumulates into a local copy so that partial results of different jobs are not written to the same cache line in the loop
+		std::atomic<std::size_t> visited{ 0 };
+		auto body = [this, &fn, &plan, &partials, &identity, &visited](std::size_t i)
+		{
+			R value = identity;
+			auto range_fn = [&fn, &value](Entity& e, typename QueryTraits<Ts>::Component&... components)
+			{
+				fn(value, e, components...);
+			};
+			visited += RunRange(range_fn, plan, plan.ranges[i]);
+			partials[i].value = std::move(value);
+		};
+		ParallelFor(entity_manager->GetThreadPool(), plan.ranges.size(), body);
+		LECS_PROFILE_ENTITIES(visited.load());
+
+		R result = identity;
+		for (auto& partial : partials) result = combine(result, partial.value);
+		return result;
+	}
+
+	// call fn(Entity&, Ts&...) for every entity of this container with components Ts...
+	template <typename... Ts, typename F>
+	void EntityContainer::ParallelForEach(F fn, std::size_t grain)
+	{
+		entity_manager.GetQuery<Ts...>().ParallelForEach(entities, fn, grain);
+	}
+
+	class SystemManager;
+
+	// profile of a system in a frame
+	struct SystemProfile
+	{
+		// id of the thread running the system
+		uint32_t thread = 0;
+
+		// time in nanoseconds since profiling started and time taken
+		uint64_t begin = 0;
+		uint64_t duration = 0;
+
+		// entities visited by queries and allocations made in the update
+		uint64_t entities = 0;
+		uint64_t allocations = 0;
 	};
 
-	// base event class for all event class
-	class Event
+	// profile of a frame of system manager
+	struct FrameProfile
+	{
+		// id of the thread updating system manager
+		uint32_t thread = 0;
+
+		uint64_t begin = 0;
+		uint64_t duration = 0;
+		DeltaTime delta_time = 0;
+	};
+
+	// base system class for all system classes
+	class System
 	{
 	private:
 
-		EventManager* event_manager;
+		friend class SystemManager;
+
+		// type keys of components read and written in Update
+		// keys do not depend on the world so systems can be compared without one
+		ComponentSignature reads;
+		ComponentSignature writes;
+
+		// exclusive system does not run at the same time as any other system
+		bool exclusive = true;
+
+		// the system runs once every tick_interval updates of system manager
+		// tick_phase is the update it runs on within the interval, assigned by system manager
+		uint32_t tick_interval = 1;
+		uint32_t tick_phase = 0;
+
+		// tick_interval changed since system manager last assigned phases
+		bool tick_changed = false;
+
+		// change tick of the last run, Changed and Added filters see changes after it
+		uint32_t last_run_tick = 0;
+
+		// get the signature of the type keys of components T...
+		template <typename... T>
+		static ComponentSignature KeySignature()
+		{
+			ComponentSignature signature;
+			int expand[] = { 0, (signature.Set(GetTypeKey<Component, T>()), 0)... };
+			(void)expand;
+			return signature;
+		}
+
+	protected:
+
+		// declare components T... are read in Update
+		// should be called in Init
+		template <typename... T>
+		void Reads()
+		{
+			reads |= KeySignature<T...>();
+			exclusive = false;
+		}
+
+		// declare components T... are written in Update
+		// should be called in Init
+		template <typename... T>
+		void Writes()
+		{
+			writes |= KeySignature<T...>();
+			exclusive = false;
+		}
+
+		// declare this system must not run at the same time as any other system
+		// systems which do not declare what they read and write are exclusive
+		// systems which add or remove entities or components directly, or emit events, should be exclusive
+		// non-exclusive systems can record entity and component changes in commands instead
+		void Exclusive()
+		{
+			exclusive = true;
+		}
 
 	public:
 
-		// event id of this event
-		uint32_t id;
+		// entity and component changes recorded in Update
+		// submitted after all systems are updated and applied in the next entity manager update
+		CommandBuffer commands;
 
-		// vector of subscribers to this event
-		std::vector<EventSubscriber*> subscribers;
+		System() = default;
+
+		// commands are not copied
+		System(const System& other)
+			: reads(other.reads), writes(other.writes), exclusive(other.exclusive), tick_interval(other.tick_interval) {}
+
+		virtual ~System() = default;
+
+		// function to be called when the system is added to system manager
+		virtual void Init(EntityManager&, EventManager&, SystemManager&) {}
+
+		// function to be called everytime system manager is updated
+		virtual void Update(EntityManager&, EventManager&, DeltaTime) {}
 
-		// set the event manager
-		void SetEventManager(EventManager* event_manager)
+		// run this system once every interval updates of system manager
+		// delta time passed to Update is the sum of delta times since it last ran
+		// can be called in Init
+		void SetTickInterval(uint32_t interval)
 		{
-			this->event_manager = event_manager;
+			interval = std::max<uint32_t>(1, interval);
+			if (interval == tick_interval) return;
+			tick_interval = interval;
+			tick_changed = true;
 		}
 
-		// downcast this event to derived event class
-		template <typename T>
-		T& Downcast()
+		// run this system about rate times per second when system manager updates update_rate times per second
+		void SetTickRate(double rate, double update_rate)
 		{
-			return static_cast<T&>(*this);
+			SetTickInterval(rate <= 0 ? 1 : static_cast<uint32_t>(update_rate / rate + 0.5));
 		}
 
-		// check whether this is of derived event class T
-		template <typename T>
-		bool IsEvent() const;
+		uint32_t GetTickInterval() const
+		{
+			return tick_interval;
+		}
+
+		// check whether this system can not run at the same time as system other
+		bool ConflictsWith(const System& other) const
+		{
+			if (exclusive || other.exclusive) return true;
+			return writes.Intersects(other.reads) || writes.Intersects(other.writes) || other.writes.Intersects(reads);
+		}
 	};
 
-	// event manager class to manage all event
-	class EventManager
+	// system manager class to manager all systems
+	class SystemManager
 	{
 	private:
 
 		EntityManager* entity_manager;
-		uint32_t next_event_id = 0;
+		EventManager* event_manager;
 
-	public:
+		uint32_t next_system_id = 0;
 
-		// vector of events
-		std::vector<std::unique_ptr<Event>> events;
+		// system id of each system type key, NULL_ID if the system type is not assigned an id
+		std::vector<uint32_t> system_ids;
 
-		EventManager() : entity_manager(nullptr) {}
-		explicit EventManager(EntityManager* entity_manager) : entity_manager(entity_manager) {}
+		// logger of the world
+		std::shared_ptr<Logger> logger = std::make_shared<Logger>();
 
-		// get the event id
-		// create a new event id if the event type is never assigned an id before
-		template <typename T>
-		inline uint32_t GetEventID()
-		{
-			static uint32_t id = next_event_id++;
-			return id;
-		}
+		// worker threads running systems, null to run systems on the calling thread
+		std::unique_ptr<ThreadPool> pool;
 
-		// unsubscribe an event from a subscriber
-		template <typename T>
-		void Unsubscribe(EventSubscriber* subscriber)
-		{
-			AddEvent<T>();
-			uint32_t id = GetEventID<T>();
-			events.at(id)->subscribers.erase(std::remove_if(
-				events.at(id)->subscribers.begin(), events.at(id)->subscribers.end(),
-				[subscriber](EventSubscriber* s)
-				{
-					return s == subscriber;
-				}),
-				events.at(id)->subscribers.end());
+		// dependency graph of systems
+		// system j depends on system i if i is added before j and they conflict
+		bool graph_dirty = true;
+		std::vector<std::vector<uint32_t>> dependencies;
+		std::vector<std::vector<uint32_t>> dependents;
 
-			std::vector<uint32_t>* subscribed = &subscriber->subscribed;
-			subscribed->erase(std::remove_if(subscribed->begin(), subscribed->end(),
-				[id](const uint32_t& eID)
-				{
-					return eID == id;
-				}),
-				subscribed->end());
+		// number of unfinished dependencies of each system in the current frame
+		std::unique_ptr<std::atomic<uint32_t>[]> remaining;
+
+		// number of unfinished systems in the current frame
+		std::atomic<std::size_t> pending{ 0 };
+
+		// number of updates done
+		uint64_t tick = 0;
+
+		// whether each system runs in the current update
+		std::vector<uint8_t> due;
+
+		// sum of delta times of each system since it last ran
+		std::vector<DeltaTime> elapsed;
+
+		// time in nanoseconds each system took in the last frame, 0 if it did not run
+		std::vector<uint64_t> system_times;
+
+		// average time in nanoseconds each system took when it ran
+		std::vector<uint64_t> average_times;
+
+		// longest chain of dependent systems of the last frame
+		std::vector<uint32_t> critical_path;
+		uint64_t critical_path_time = 0;
+		std::vector<uint64_t> path_times;
+		std::vector<int64_t> path_prev;
+
+#ifdef LECS_PROFILE
+		// time profiling started, times of profiles are relative to it
+		std::chrono::steady_clock::time_point profile_epoch = std::chrono::steady_clock::now();
+
+		// ring buffers of the last PROFILE_FRAMES frames
+		// system_profiles stores the profiles of all systems of a frame together
+		std::array<FrameProfile, PROFILE_FRAMES> frame_profiles;
+		std::vector<SystemProfile> system_profiles;
+		std::size_t profiled_frames = 0;
+
+		uint64_t ProfileTime(std::chrono::steady_clock::time_point time) const
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - profile_epoch).count());
 		}
 
-		// subscribe event T from subscriber
-		template <typename T>
-		void Subscribe(EventSubscriber* subscriber)
+		SystemProfile& CurrentProfile(std::size_t index)
 		{
-			AddEvent<T>();
-			events.at(GetEventID<T>())->subscribers.emplace_back(subscriber);
-			subscriber->subscribed.emplace_back(GetEventID<T>());
+			return system_profiles[(profiled_frames % PROFILE_FRAMES) * systems.size() + index];
 		}
+#endif
 
-		// emit event T to all subscriber of that event
-		// pass in aArgs to constructor of event T
-		template <typename T, typename... TArgs>
-		void Emit(TArgs... aArgs)
+		// build the dependency graph of systems
+		void BuildGraph()
 		{
-			AddEvent<T>();
-			for (auto& sub : events.at(GetEventID<T>())->subscribers)
+			std::size_t n = systems.size();
+			dependencies.assign(n, std::vector<uint32_t>());
+			dependents.assign(n, std::vector<uint32_t>());
+			remaining.reset(new std::atomic<uint32_t>[n]);
+			due.assign(n, 0);
+			elapsed.resize(n, 0);
+			system_times.assign(n, 0);
+			average_times.resize(n, 0);
+			path_times.assign(n, 0);
+			path_prev.assign(n, -1);
+			critical_path.reserve(n);
+
+#ifdef LECS_PROFILE
+			// history of a different set of systems is dropped
+			if (system_profiles.size() != PROFILE_FRAMES * n)
 			{
-				T ev(T(std::forward<TArgs>(aArgs)...));
-				ev.SetEventManager(this);
-				ev.id = GetEventID<T>();
-				sub->Receive(ev);
+				system_profiles.assign(PROFILE_FRAMES * n, SystemProfile());
+				profiled_frames = 0;
 			}
+#endif
 
-			logger.AddLog
-			(
-				"Event emitted: Event " + std::string(typeid(T).name()) + " emitted",
-				LT_EVENT
-			);
+			for (uint32_t j = 0; j < n; ++j)
+			{
+				if (!systems[j]) continue;
+				for (uint32_t i = 0; i < j; ++i)
+				{
+					if (!systems[i] || !systems[i]->ConflictsWith(*systems[j])) continue;
+					dependencies[j].push_back(i);
+					dependents[i].push_back(j);
+				}
+			}
+
+			graph_dirty = false;
+			BalanceTicks();
 		}
 
-		// add event type T
-		template <typename T>
-		bool AddEvent()
+		// run system at index and time it
+		void RunSystem(std::size_t index)
 		{
-			if (GetEventID<T>() < events.size()) return false;
-			T* ev(new T());
-			ev->id = GetEventID<T>();
-			std::unique_ptr<T> u_ptr{ ev };
-			events.resize(events.size() + 1);
-			events.at(ev->id) = std::move(u_ptr);
+#ifdef LECS_PROFILE
+			ProfileCounters& counters = GetProfileCounters();
+			uint64_t entities = counters.entities;
+			uint64_t allocations = counters.allocations;
+#endif
 
-			logger.AddLog
-			(
-				"Event created: Event " + std::string(typeid(T).name()) + " created",
-				LT_EVENT, LT_CREATE
-			);
+			if (!due[index])
+			{
+				system_times[index] = 0;
+				return;
+			}
 
-			return true;
+			// changes made by the system are marked with a new tick
+			System& system = *systems[index];
+			SystemTicks& ticks = GetSystemTicks();
+			SystemTicks outer = ticks;
+			ticks.entity_manager = entity_manager;
+			ticks.tick = entity_manager->AdvanceChangeTick();
+			ticks.last_run = system.last_run_tick;
+
+			auto begin = std::chrono::steady_clock::now();
+			system.Update(*entity_manager, *event_manager, elapsed[index]);
+			auto end = std::chrono::steady_clock::now();
+
+			system.last_run_tick = ticks.tick;
+			ticks = outer;
+
+			system_times[index] = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+			average_times[index] = average_times[index] == 0 ? system_times[index] : (average_times[index] * 7 + system_times[index]) / 8;
+			elapsed[index] = 0;
+
+#ifdef LECS_PROFILE
+			SystemProfile& profile = CurrentProfile(index);
+			profile.thread = counters.thread;
+			profile.begin = ProfileTime(begin);
+			profile.duration = system_times[index];
+			profile.entities = counters.entities - entities;
+			profile.allocations = counters.allocations - allocations;
+#endif
 		}
-	};
-
-	// check whether this is of derived event class T
-	template <typename T>
-	bool Event::IsEvent() const
-	{
-		return id == event_manager->GetEventID<T>();
-	}
 
-	class SystemManager;
-	
-	// base system class for all system classes
-	class System
-	{
-	public:
+		// job function of a system run by the thread pool
+		static void RunSystemJob(void* context, std::size_t index)
+		{
+			auto& self = *static_cast<SystemManager*>(context);
+			self.RunSystem(index);
 
-		// function to be called when the system is added to system manager
-		virtual void Init(EntityManager&, EventManager&, SystemManager&) {}
+			for (auto d : self.dependents[index])
+			{
+				if (--self.remaining[d] == 0) self.pool->Submit(Job{ &SystemManager::RunSystemJob, context, d });
+			}
+			--self.pending;
+		}
 
-		// function to be called everytime system manager is updated
-		virtual void Update(EntityManager&, EventManager&, DeltaTime) {}
-	};
+		// find the longest chain of dependent systems by time
+		void ComputeCriticalPath()
+		{
+			critical_path.clear();
+			critical_path_time = 0;
 
-	// system manager class to manager all systems
-	class SystemManager
-	{
-	private:
+			int64_t last = -1;
+			for (std::size_t j = 0; j < systems.size(); ++j)
+			{
+				path_times[j] = system_times[j];
+				path_prev[j] = -1;
+				for (auto i : dependencies[j])
+				{
+					if (path_times[i] + system_times[j] > path_times[j])
+					{
+						path_times[j] = path_times[i] + system_times[j];
+						path_prev[j] = i;
+					}
+				}
 
-		EntityManager* entity_manager;
-		EventManager* event_manager;
+				if (last == -1 || path_times[j] > critical_path_time)
+				{
+					critical_path_time = path_times[j];
+					last = static_cast<int64_t>(j);
+				}
+			}
 
-		uint32_t next_system_id = 0;
+			for (; last != -1; last = path_prev[last])
+			{
+				critical_path.push_back(static_cast<uint32_t>(last));
+			}
+			std::reverse(critical_path.begin(), critical_path.end());
+		}
 
 	public:
 
@@ -700,13 +6725,32 @@ namespace lecs
 		explicit SystemManager(EntityManager* entity_manager, EventManager* event_manager)
 			: entity_manager(entity_manager), event_manager(event_manager) {}
 
+		~SystemManager()
+		{
+			if (pool && entity_manager && entity_manager->GetThreadPool() == pool.get()) entity_manager->SetThreadPool(nullptr);
+		}
+
+		// get the logger of the world
+		Logger& GetLogger() const
+		{
+			return *logger;
+		}
+
+		// replace the logger of the world
+		void SetLogger(std::shared_ptr<Logger> new_logger)
+		{
+			logger = std::move(new_logger);
+		}
+
 		// get the system id
-		// create a new system id if the system type is never assigned an id before
+		// create a new system id if the system type is never assigned an id by this system manager before
 		template <typename T>
-		inline uint32_t GetSystemID()
+		uint32_t GetSystemID()
 		{
-			static uint32_t id = next_system_id++;
-			return id;
+			uint32_t key = GetTypeKey<System, T>();
+			if (key >= system_ids.size()) system_ids.resize(key + 1, NULL_ID);
+			if (system_ids[key] == NULL_ID) system_ids[key] = next_system_id++;
+			return system_ids[key];
 		}
 
 		// add system of class T
@@ -714,18 +6758,19 @@ namespace lecs
 		template <typename T>
 		T& AddSystem(const T& s)
 		{
-			std::unique_ptr<System> u_ptr{ s };
+			T* ptr(new T(s));
+			std::unique_ptr<System> u_ptr{ ptr };
 			systems.resize(systems.size() + 1);
-			auto ptr = u_ptr.get();
 			systems.at(GetSystemID<T>()) = std::move(u_ptr);
-			ptr->Init(entity_manager, event_manager, this);
+			graph_dirty = true;
+			ptr->Init(*entity_manager, *event_manager, *this);
 
-			logger.AddLog
+			LECS_LOG_INFO
 			(
-				"System created: System " + std::string(typeid(T).name()) + " created",
+				LM_SYSTEM_CREATED, NULL_ID, GetSystemID<T>(), typeid(T).name(),
 				LT_SYSTEM, LT_CREATE
 			);
-			return *s;
+			return *ptr;
 		}
 
 		// pass in unique_ptr of T
@@ -733,16 +6778,17 @@ namespace lecs
 		T& AddSystem(std::unique_ptr<T> u_ptr)
 		{
 			systems.resize(systems.size() + 1);
-			auto ptr = u_ptr.get();
+			T* ptr = u_ptr.get();
 			systems.at(GetSystemID<T>()) = std::move(u_ptr);
-			ptr->Init(entity_manager, event_manager, this);
+			graph_dirty = true;
+			ptr->Init(*entity_manager, *event_manager, *this);
 
-			logger.AddLog
+			LECS_LOG_INFO
 			(
-				"System created: System " + std::string(typeid(T).name()) + " created",
+				LM_SYSTEM_CREATED, NULL_ID, GetSystemID<T>(), typeid(T).name(),
 				LT_SYSTEM, LT_CREATE
 			);
-			return *u_ptr.get();
+			return *ptr;
 		}
 
 		// pass in constructor arguments of T
@@ -753,11 +6799,12 @@ namespace lecs
 			std::unique_ptr<System> u_ptr{ s };
 			systems.resize(systems.size() + 1);
 			systems.at(GetSystemID<T>()) = std::move(u_ptr);
+			graph_dirty = true;
 			s->Init(*entity_manager, *event_manager, *this);
 
-			logger.AddLog
+			LECS_LOG_INFO
 			(
-				"System created: System " + std::string(typeid(T).name()) + " created",
+				LM_SYSTEM_CREATED, NULL_ID, GetSystemID<T>(), typeid(T).name(),
 				LT_SYSTEM, LT_CREATE
 			);
 			return *s;
@@ -768,26 +6815,263 @@ namespace lecs
 		T& GetSystem()
 		{
 			System* ptr(systems.at(GetSystemID<T>()).get());
-			if (ptr == nullptr) logger.AddLog
+			if (ptr == nullptr) LECS_LOG_WARNING
 			(
-				"Warning: " + std::string(typeid(T).name()) + " does not exist, returned nullptr",
+				LM_SYSTEM_MISSING, NULL_ID, GetSystemID<T>(), typeid(T).name(),
 				LT_WARNING
 			);
 			return *static_cast<T*>(ptr);
 		}
 
-		// update all systems
+		// set the number of worker threads used to run non-conflicting systems at the same time
+		// the workers also run the jobs of parallel for each of entity manager
+		// 0 to run all systems one after another on the calling thread
+		void SetWorkerCount(std::size_t n_worker)
+		{
+			if (entity_manager) entity_manager->SetThreadPool(nullptr);
+			if (n_worker == 0) pool.reset();
+			else pool.reset(new ThreadPool(n_worker));
+			if (entity_manager) entity_manager->SetThreadPool(pool.get());
+		}
+
+		// spread systems with the same tick interval over the updates of the interval
+		// systems are placed from the slowest, each on the phase with the least load so far
+		// called when systems are added, call again to use the average times measured since
+		void BalanceTicks()
+		{
+			// updates after which the pattern of intervals repeats, capped to keep it small
+			uint64_t horizon = 1;
+			for (auto& s : systems)
+			{
+				if (!s) continue;
+				uint64_t a = horizon, b = s->tick_interval;
+				while (b)
+				{
+					uint64_t r = a % b;
+					a = b;
+					b = r;
+				}
+				horizon = std::min<uint64_t>(horizon / a * s->tick_interval, std::max<uint64_t>(1024, s->tick_interval));
+			}
+
+			std::vector<uint32_t> order;
+			for (uint32_t i = 0; i < systems.size(); ++i)
+			{
+				if (systems[i]) order.push_back(i);
+			}
+			std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+			{
+				return average_times[a] > average_times[b];
+			});
+
+			std::vector<uint64_t> load(static_cast<std::size_t>(horizon), 0);
+			for (auto i : order)
+			{
+				System& s = *systems[i];
+				uint64_t cost = std::max<uint64_t>(1, average_times[i]);
+
+				uint32_t best = 0;
+				uint64_t best_load = UINT64_MAX;
+				for (uint32_t phase = 0; phase < s.tick_interval; ++phase)
+				{
+					uint64_t peak = 0;
+					for (uint64_t t = phase; t < horizon; t += s.tick_interval) peak = std::max(peak, load[t]);
+					if (peak < best_load)
+					{
+						best = phase;
+						best_load = peak;
+					}
+				}
+
+				s.tick_phase = best;
+				s.tick_changed = false;
+				for (uint64_t t = best; t < horizon; t += s.tick_interval) load[t] += cost;
+			}
+		}
+
+		// update all systems due in this update
+		// systems depending on each other run in the order they are added
+		// systems are placed on phases again if the tick interval of some changed
 		void Update(DeltaTime delta_time)
 		{
+			if (graph_dirty) BuildGraph();
+			else if (std::any_of(systems.begin(), systems.end(), [](const std::unique_ptr<System>& s) { return s && s->tick_changed; }))
+			{
+				BalanceTicks();
+			}
+
+			for (std::size_t i = 0; i < systems.size(); ++i)
+			{
+				if (!systems[i]) continue;
+				elapsed[i] += delta_time;
+				due[i] = tick % systems[i]->tick_interval == systems[i]->tick_phase;
+			}
+			++tick;
+
+#ifdef LECS_PROFILE
+			auto frame_begin = std::chrono::steady_clock::now();
+#endif
+
+			if (!pool)
+			{
+				for (std::size_t i = 0; i < systems.size(); ++i) RunSystem(i);
+			}
+			else
+			{
+				pending = systems.size();
+				for (std::size_t i = 0; i < systems.size(); ++i)
+				{
+					remaining[i] = static_cast<uint32_t>(dependencies[i].size());
+				}
+				for (std::size_t i = 0; i < systems.size(); ++i)
+				{
+					if (dependencies[i].empty()) pool->Submit(Job{ &SystemManager::RunSystemJob, this, i });
+				}
+				pool->Wait(pending);
+			}
+
 			for (auto& s : systems)
 			{
-				s->Update(*entity_manager, *event_manager, delta_time);
+				if (s && !s->commands.Empty()) entity_manager->Submit(s->commands);
+			}
+
+			ComputeCriticalPath();
+
+#ifdef LECS_PROFILE
+			FrameProfile& frame = frame_profiles[profiled_frames % PROFILE_FRAMES];
+			frame.thread = GetProfileCounters().thread;
+			frame.begin = ProfileTime(frame_begin);
+			frame.duration = ProfileTime(std::chrono::steady_clock::now()) - frame.begin;
+			frame.delta_time = delta_time;
+			++profiled_frames;
+#endif
+		}
+
+		// get the time in nanoseconds system at index took in the last frame
+		uint64_t GetSystemTime(std::size_t index) const
+		{
+			return system_times.at(index);
+		}
+
+		// get the index of systems of the longest chain of dependent systems in the last frame
+		// this chain limits how short a frame can be with any number of workers
+		const std::vector<uint32_t>& GetCriticalPath() const
+		{
+			return critical_path;
+		}
+
+		// get the time in nanoseconds of the critical path in the last frame
+		uint64_t GetCriticalPathTime() const
+		{
+			return critical_path_time;
+		}
+
+		// get the critical path of the last frame in string
+		std::string GetCriticalPathReport() const
+		{
+			std::string report = "Critical path: " + std::to_string(critical_path_time) + "ns";
+			for (auto i : critical_path)
+			{
+				report += "\n    System " + std::string(typeid(*systems[i]).name()) + " " + std::to_string(system_times[i]) + "ns";
+			}
+			return report;
+		}
+
+		// get the number of frames in the profile history, at most PROFILE_FRAMES
+		// always 0 if LECS_PROFILE is not defined
+		std::size_t GetProfiledFrameCount() const
+		{
+#ifdef LECS_PROFILE
+			return std::min(profiled_frames, PROFILE_FRAMES);
+#else
+			return 0;
+#endif
+		}
+
+#ifdef LECS_PROFILE
+		// get the profile of frame, 0 is the last frame
+		const FrameProfile& GetFrameProfile(std::size_t frame) const
+		{
+			return frame_profiles[(profiled_frames - 1 - frame) % PROFILE_FRAMES];
+		}
+
+		// get the profile of system at index in frame, 0 is the last frame
+		const SystemProfile& GetSystemProfile(std::size_t frame, std::size_t index) const
+		{
+			return system_profiles[((profiled_frames - 1 - frame) % PROFILE_FRAMES) * systems.size() + index];
+		}
+#endif
+
+		// write the profile history in chrome trace event json
+		// open it with chrome://tracing or perfetto
+		// writes no event if LECS_PROFILE is not defined
+		void ExportChromeTrace(std::ostream& os) const
+		{
+			os << "{\"traceEvents\":[";
+
+#ifdef LECS_PROFILE
+			// times are written in microseconds with 3 decimal places
+			auto write_time = [&os](uint64_t ns)
+			{
+				os << ns / 1000 << "." << ns % 1000 / 100 << ns % 100 / 10 << ns % 10;
+			};
+
+			// write a complete event without closing it, args are written after it
+			bool first = true;
+			auto write_event = [&](const std::string& name, const char* category, uint32_t thread, uint64_t begin, uint64_t duration)
+			{
+				if (!first) os << ",";
+				first = false;
+				os << "\n{\"name\":\"" << name << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread << ",\"ts\":";
+				write_time(begin);
+				os << ",\"dur\":";
+				write_time(duration);
+			};
+
+			std::vector<std::string> names(systems.size());
+			for (std::size_t i = 0; i < systems.size(); ++i)
+			{
+				if (!systems[i]) continue;
+				for (const char* c = typeid(*systems[i]).name(); *c; ++c)
+				{
+					if (*c == '"' || *c == '\\') names[i] += '\\';
+					names[i] += *c;
+				}
+			}
+
+			for (std::size_t f = GetProfiledFrameCount(); f-- > 0;)
+			{
+				const FrameProfile& frame = GetFrameProfile(f);
+				write_event("Frame", "frame", frame.thread, frame.begin, frame.duration);
+				os << ",\"args\":{\"delta_time\":" << frame.delta_time << "}}";
+
+				for (std::size_t i = 0; i < systems.size(); ++i)
+				{
+					if (!systems[i]) continue;
+					const SystemProfile& profile = GetSystemProfile(f, i);
+					write_event(names[i], "system", profile.thread, profile.begin, profile.duration);
+					os << ",\"args\":{\"entities\":" << profile.entities << ",\"allocations\":" << profile.allocations << "}}";
+				}
 			}
+#endif
+
+			os << "\n]}\n";
 		}
 	};
 
 	// ecs managers class to store all managers
 	// optional to be used
+	// points in ECSManagers::UpdateECSManagers to dispatch events
+	enum EventDispatchPoint
+	{
+		EDP_NONE,
+		EDP_BEFORE_ENTITIES,
+		EDP_BEFORE_SYSTEMS,
+		EDP_AFTER_SYSTEMS
+	};
+
+	// a world of entities, events and systems
+	// worlds share no mutable state, so each one can be updated on its own thread
 	class ECSManagers
 	{
 	public:
@@ -801,13 +7085,18 @@ namespace lecs
 			entity_manager = new EntityManager();
 			event_manager = new EventManager(entity_manager);
 			system_manager = new SystemManager(entity_manager, event_manager);
+
+			std::shared_ptr<Logger> logger = std::make_shared<Logger>();
+			entity_manager->SetLogger(logger);
+			event_manager->SetLogger(logger);
+			system_manager->SetLogger(logger);
 		}
 
 		ECSManagers& operator=(const ECSManagers& other)
 		{
-			if (entity_manager) delete entity_manager;
-			if (event_manager) delete event_manager;
 			if (system_manager) delete system_manager;
+			if (event_manager) delete event_manager;
+			if (entity_manager) delete entity_manager;
 
 			entity_manager = other.entity_manager;
 			event_manager = other.event_manager;
@@ -816,11 +7105,64 @@ namespace lecs
 			return *this;
 		}
 
+		// point in update to dispatch queued and posted events
+		EventDispatchPoint event_dispatch_point = EDP_BEFORE_SYSTEMS;
+
+		// delta time of each fixed step, 0 to update once per call with the delta time passed in
+		DeltaTime fixed_step = 0;
+
+		// max number of fixed steps in one call
+		// time beyond it is dropped so that slow frames do not make the next frames slower
+		uint32_t max_steps = 4;
+
+		// time not yet simulated by fixed steps
+		DeltaTime accumulator = 0;
+
 		// update all ecs managers
-		void UpdateECSManagers(DeltaTime delta_time = NULL)
+		// with fixed_step, update every fixed step of time passed, at most max_steps times
+		// return the number of updates done
+		uint32_t UpdateECSManagers(DeltaTime delta_time = 0)
+		{
+			if (fixed_step == 0)
+			{
+				Step(delta_time);
+				return 1;
+			}
+
+			accumulator += delta_time;
+			uint32_t steps = 0;
+			while (accumulator >= fixed_step && steps < max_steps)
+			{
+				Step(fixed_step);
+				accumulator -= fixed_step;
+				++steps;
+			}
+			if (accumulator >= fixed_step) accumulator %= fixed_step;
+			return steps;
+		}
+
+		// fraction of a fixed step of time not yet simulated, to interpolate rendering
+		float GetStepFraction() const
+		{
+			return fixed_step == 0 ? 0.f : static_cast<float>(accumulator) / fixed_step;
+		}
+
+		// get the logger shared by the managers of this world
+		Logger& GetLogger() const
+		{
+			return entity_manager->GetLogger();
+		}
+
+	private:
+
+		// update all ecs managers once
+		void Step(DeltaTime delta_time)
 		{
+			if (event_dispatch_point == EDP_BEFORE_ENTITIES) event_manager->Dispatch();
 			entity_manager->Update();
+			if (event_dispatch_point == EDP_BEFORE_SYSTEMS) event_manager->Dispatch();
 			system_manager->Update(delta_time);
+			if (event_dispatch_point == EDP_AFTER_SYSTEMS) event_manager->Dispatch();
 		}
 	};
 }
@@ -11,6 +11,7 @@ namespace lio
 	size_t memory_count = 0;
 	size_t memory_used = 0;
 	size_t memory_peak = 0;
+	size_t memory_allocations = 0;
 
 	void PrintMemUsage(uint8_t args)
 	{
@@ -21,6 +22,8 @@ namespace lio
 			std::cout << "count: " << memory_count << " ";
 		if (args & PEAK)
 			std::cout << "peak: " << memory_peak << " ";
+		if (args & ALLOCATIONS)
+			std::cout << "allocations: " << memory_allocations << " ";
 		std::cout << std::endl;
 	}
 }
@@ -35,6 +38,7 @@ void* operator new(size_t size)
 	ptr[0] = size;
 	lio::memory_used += size;
 	++lio::memory_count;
+	++lio::memory_allocations;
 
 	if (lio::memory_used > lio::memory_peak)
 		lio::memory_peak = lio::memory_used;
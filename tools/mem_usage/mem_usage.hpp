@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 namespace lio
 {
@@ -8,12 +9,16 @@ namespace lio
 	{
 		USAGE = 0b001,
 		COUNT = 0b010,
-		PEAK = 0b100
+		PEAK = 0b100,
+		ALLOCATIONS = 0b1000
 	};
 
 	extern size_t memory_count;
 	extern size_t memory_used;
 	extern size_t memory_peak;
 
+	// number of allocations made so far, never decreased
+	extern size_t memory_allocations;
+
 	void PrintMemUsage(uint8_t args = USAGE);
 }
\ No newline at end of file